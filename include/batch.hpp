@@ -0,0 +1,32 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <executor.hpp>
+#include <results.hpp>
+
+// numbers buffered between two evaluations, bounds memory on huge inputs
+const std::size_t QUERY_WINDOW = 1 << 22;
+
+// Runs a query script non-interactively: the same lines the REPL accepts
+// (function numbers, @n [alpha...], $, $>file, $=, $%, ?f, ?$, =f, [f g],
+// $[f g], exit) read from a file or "-" for stdin. Only answers are written, in
+// input order: Yes/No per number, the function list plus count per $ and
+// $[f g], "f orbitSize" lines plus count per $= and =f, and the REPL's lines
+// for $>file, $%, ?f, ?$ and [f g]. A results file instead answers
+// Yes/No for every function it stores, under its own n and alpha.
+// Returns the process exit code.
+int runBatch(Executor* executor, const char* path);
+
+// "[f g]", the bounds of an interval query as numbers or 0x tables of size
+// variables, optionally separated by a comma
+bool parseInterval(const std::string& text, int size, uint64_t& lower, uint64_t& upper);
+
+// "$>file": every monotone function of the current n and alpha into a results
+// file, false on I/O errors
+bool writeMonotoneList(Executor* executor, const std::string& path, uint64_t& count);
+
+// "$%": the histograms of one statistics pass as CSV sections (weight,count,
+// then minimal terms, degree and the offset,count chunks of 5.csv)
+std::string formatStatistics(const MonotoneStatistics& statistics);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef COFACTORS_HPP
+#define COFACTORS_HPP
+
+#include <cstdint>
+
+// Shift/mask helpers on function numbers of n <= 6 variables, shared by the
+// executor, the ranking tables and cltest's host side. The OpenCL kernels
+// keep their own copies in kernel_p.cl and kernel_b.cl.
+
+// per input bit j: function number positions with bit j clear, where input
+// bit j is 1; position p + 2^j is the same input with bit j cleared
+const uint64_t VARIABLE_MASKS[6] = {
+    0x5555555555555555ULL, 0x3333333333333333ULL, 0x0F0F0F0F0F0F0F0FULL,
+    0x00FF00FF00FF00FFULL, 0x0000FFFF0000FFFFULL, 0x00000000FFFFFFFFULL,
+};
+
+// True when positions p and p + 2^j above the low lowBits already break the
+// order of variable j (decreasing where bit j of decreasing is set); every
+// number sharing those high bits then fails too.
+inline bool prefixFails(uint64_t f, int n, uint32_t decreasing, int lowBits) {
+    uint64_t fixed = lowBits < 64 ? ~((1ULL << lowBits) - 1) : 0;
+
+    for (int j = 0; j < n; j++) {
+        uint64_t neighbour = f >> (1 << j);
+        uint64_t broken = (decreasing >> j) & 1 ? f & ~neighbour : neighbour & ~f;
+
+        if (broken & VARIABLE_MASKS[j] & fixed) return true;
+    }
+
+    return false;
+}
+
+// f(~x) is the table reversed, which swaps p with p ^ 2^j for every j;
+// self-dual means the reversed table is the complement (as in kernel_b.cl)
+inline bool isSelfDual(uint64_t f, int n) {
+    uint64_t tableMask = n == 6 ? ~0ULL : (1ULL << (1 << n)) - 1;
+    uint64_t reversed = f;
+
+    for (int j = 0; j < n; j++) {
+        int s = 1 << j;
+        reversed = ((reversed & VARIABLE_MASKS[j]) << s) | ((reversed >> s) & VARIABLE_MASKS[j]);
+    }
+
+    return reversed == (~f & tableMask);
+}
+
+#endif
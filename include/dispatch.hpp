@@ -0,0 +1,70 @@
+#ifndef DISPATCH_HPP
+#define DISPATCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Instruction set extensions of the running CPU, including OS support for the
+// wider registers. The Makefile builds without -m flags; routines compiled for
+// wider targets in dispatch.cpp are only bound when these report them.
+struct CpuFeatures {
+    bool popcnt = false;
+    bool bmi2 = false;
+    bool avx2 = false;
+    bool avx512f = false;
+    bool avx512vpopcntdq = false;
+    bool avx512vbmi = false;
+};
+
+// Tiers of the routines in Kernels, each needs the features of the ones
+// before it. Only those routines are dispatched; the transform engine,
+// tightenInterval and the rest of the executor are built for the baseline
+// target.
+enum class CpuLevel {
+    Generic, // any x86-64, and every other architecture
+    Avx2,    // AVX2, BMI2 and POPCNT, 4 numbers per instruction
+    Avx512,  // AVX-512F, 8 numbers per instruction (VPOPCNTDQ where present)
+};
+
+// Detected on first use.
+const CpuFeatures& getCpuFeatures();
+
+// Best tier of this CPU; QMF_CPU=generic, avx2 or avx512 lowers it.
+CpuLevel getCpuLevel();
+
+const char* toString(CpuLevel level);
+
+// The packed engine's cofactor test on one word of up to 6 variables, see
+// Executor::preparePackedEngine. Masks of variables with the other
+// orientation are 0, so each variable costs the same branch-free steps.
+struct PackedCheck {
+    int bits = 0;               // variables inside the word, min(n, 6)
+    uint64_t functionMask = 0;  // function number bits of the word
+    uint32_t increasingBits = 0; // bit b set when position bit b is increasing
+    uint64_t increasing[6] = {};
+    uint64_t decreasing[6] = {};
+};
+
+// Routines of one tier. Bitmaps are laid out as in
+// Executor::calculateMonotonicityBatch; all are safe to call from any thread.
+struct Kernels {
+    CpuLevel level;
+
+    void (*checkBatch)(const PackedCheck& check, const uint64_t* numbers, std::size_t count, uint64_t* bitmap);
+
+    // the numbers first, first + 1, ..., first + count - 1
+    void (*checkRange)(const PackedCheck& check, uint64_t first, std::size_t count, uint64_t* bitmap);
+
+    // false when a word of a multiword table breaks the order inside it
+    bool (*checkWords)(const PackedCheck& check, const uint64_t* words, std::size_t count);
+
+    // Per monotone function: true points, minimal true points in the alpha
+    // order and the variable count of its longest minimal term.
+    void (*describe)(const PackedCheck& check, const uint64_t* functions, std::size_t count, uint8_t* weights,
+                     uint8_t* minimalTerms, uint8_t* degrees);
+};
+
+// The routines of level, or of the best tier below it this CPU supports.
+const Kernels& getKernels(CpuLevel level);
+
+#endif
@@ -2,34 +2,365 @@
 #define EXECUTOR_HPP
 
 #include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <Eigen/Dense>
 
+#include <dispatch.hpp>
+#include <ranking.hpp>
+#include <store.hpp>
+#include <truthtable.hpp>
+
 typedef uint64_t bignum_t;
 
+// largest n whose function numbers fit into one 64-bit word
+const int MAX_PACKED_SIZE = 6;
+
+// configurations whose precomputed tables an executor keeps by default
+const std::size_t DEFAULT_CACHE_CAPACITY = 16;
+
+// largest n the executor accepts, truth tables of 2^16 bits
+const int MAX_VECTOR_SPACE_SIZE = 16;
+
+// the quick transform keeps coefficients in int8_t and the operators are
+// dense 2^n x 2^n matrices, so that engine stops here
+const int MAX_TRANSFORM_SIZE = 6;
+
+// largest n answered from a precomputed table (2^16 bits at n=4)
+const int MAX_TABLE_SIZE = 4;
+
+// largest n countUnateFunctions handles, 2^n orientations of every
+// monotone function are kept in memory
+const int MAX_UNATE_COUNT_SIZE = 5;
+
+// Orientations under which a function is monotone; bit i stands for x_{i+1},
+// the variable alpha[i] of changeVectorSpaceSize orients.
+struct Unateness {
+    uint32_t increasing; // monotone with alpha[i] = 1
+    uint32_t decreasing; // monotone with alpha[i] = 0
+
+    // f is monotone for some alpha iff every variable allows a direction
+    bool isUnate(int size) const { return (increasing | decreasing) == (1u << size) - 1; }
+};
+
+// "alpha = 1 0 * 1" with * for variables f does not depend on, or "not unate"
+std::string toString(const Unateness& unateness, int size);
+
+// Histograms over the monotone functions in [first, last], filled by
+// Executor::collectStatistics; entry i counts the functions with value i.
+struct MonotoneStatistics {
+    uint64_t total = 0;
+    std::vector<uint64_t> byWeight;       // true points, the energy of the kernels
+    std::vector<uint64_t> byMinimalTerms; // minimal true points in the alpha order
+    std::vector<uint64_t> byDegree;       // variables of the longest minimal term, 0 without any
+    std::vector<uint64_t> byChunk;        // chunk i starts at first + i * chunkSize
+    widenum_t first = 0;
+    widenum_t chunkSize = 1;
+
+    // adds the counts of other, which must cover the same n and chunks
+    void merge(const MonotoneStatistics& other);
+};
+
+class Executor;
+
+// Pull-based enumeration from Executor::monotoneFunctions: next() fills the
+// following batch of monotone function numbers in increasing order, so no
+// more than one batch is ever held and the enumeration only runs as fast as
+// the consumer asks. Range-for walks the numbers one by one through the same
+// batches. The executor must outlive the generator and keep its n and alpha.
+class MonotoneGenerator {
+public:
+    class iterator {
+    public:
+        widenum_t operator*() const { return mGenerator->mBatch[mPosition]; }
+
+        iterator& operator++();
+
+        bool operator!=(const iterator& other) const { return mGenerator != other.mGenerator || mPosition != other.mPosition; }
+
+    private:
+        friend class MonotoneGenerator;
+
+        explicit iterator(MonotoneGenerator* generator = nullptr) : mGenerator(generator) {}
+
+        MonotoneGenerator* mGenerator;
+        std::size_t mPosition = 0;
+    };
+
+    // The next batch, false and empty once the range is exhausted.
+    bool next(std::vector<widenum_t>& batch);
+
+    iterator begin();
+
+    iterator end() { return iterator(); }
+
+private:
+    friend class Executor;
+
+    MonotoneGenerator(const Executor* executor, widenum_t first, widenum_t last, std::size_t batchSize);
+
+    const Executor* mExecutor;
+    widenum_t mNext;
+    widenum_t mLast;
+    std::size_t mBatchSize;
+    bool mDone;
+    std::vector<widenum_t> mBatch; // iteration only
+};
+
+enum class Engine {
+    Transform, // quick transform criterion, works on unpacked tables
+    Table,     // precomputed answer bitmap, n <= MAX_TABLE_SIZE
+    Packed,    // shift/mask cofactor comparisons on the function number, n <= MAX_PACKED_SIZE
+               // (multiword tables beyond that)
+    Store,     // lookup in the mapped store of the current n and alpha, packed without one
+};
+
 class Executor {
+    friend class MonotoneGenerator;
+
 public:
-    Executor();
+    // verbose executors print the transform operators on every reconfiguration
+    explicit Executor(bool verbose = true);
 
     void changeVectorSpaceSize(int size, int* alpha = nullptr);
 
+    // Directory of stores written by writeMonotoneStore; changeVectorSpaceSize
+    // maps the one of the new n and alpha when it exists. Empty turns it off.
+    void setStoreDirectory(const std::string& directory);
+
+    bool hasStore() const { return mStore.isOpen(); }
+
+    // Changing back to one of the last capacity n and alpha sets reuses its
+    // operators, answer table, permutation network and interval counts
+    // instead of building them again; the least recently used one goes first.
+    void setCacheCapacity(std::size_t capacity);
+
+    // Directory for precomputation kept across runs: the operators, answer
+    // table and permutation network of each n <= 6 and alpha
+    // ("tables-<n>-<alpha>.qmc") and the ranking tables, the one part that
+    // takes seconds (n = 7). Each is read from there when present and written
+    // there after being built; interval counts stay in memory. Empty keeps
+    // everything in memory only.
+    void setCacheDirectory(const std::string& directory);
+
+    // Writes the sorted monotone functions of size <= MAX_PACKED_SIZE
+    // variables and the given alpha into directory, false on I/O errors.
+    static bool writeMonotoneStore(const std::string& directory, int size, const std::vector<int>& alpha);
+
+    // Looks the number up in the store when one is mapped, unless debug
+    // output asks for the transform.
     bool calculateMonotonicity(std::size_t functionNumber, bool debug = false);
 
+    // Packed engine on a table of the current size, any n up to MAX_VECTOR_SPACE_SIZE.
+    bool calculateMonotonicity(const TruthTable& table) const;
+
+    bool checkMonotonicity(bignum_t functionNumber, Engine engine);
+
+    // Every orientation at once, from one pass over the cofactors; does not
+    // depend on the alpha set of the executor.
+    Unateness calculateUnateness(const TruthTable& table) const;
+
+    Unateness calculateUnateness(uint64_t functionNumber) const;
+
+    // Number of functions monotone under at least one alpha, n <= MAX_UNATE_COUNT_SIZE.
+    uint64_t countUnateFunctions() const;
+
+    // Sorted numbers of all monotone functions (alpha = 1) of size <= MAX_PACKED_SIZE
+    // variables, built from pairs of monotone cofactors f0 <= f1.
+    static std::vector<uint64_t> listMonotoneFunctions(int size);
+
+    // Bit i % 64 of resultBitmap[i / 64] is set when numbers[i] is monotone.
+    // The bitmap must hold (count + 63) / 64 words. Uses the fastest engine
+    // for the current n and only reads state prepared by changeVectorSpaceSize,
+    // so any number of threads may call it at once.
+    void calculateMonotonicityBatch(const uint64_t* numbers, std::size_t count, uint64_t* resultBitmap) const;
+
+    // Same as above for the numbers first, first + 1, ..., first + count - 1.
+    void calculateMonotonicityRange(uint64_t first, std::size_t count, uint64_t* resultBitmap) const;
+
+    // Position of functionNumber among the monotone functions of the current n
+    // and alpha in increasing order; false when it is not monotone or no
+    // store is mapped.
+    bool findMonotoneIndex(uint64_t functionNumber, uint64_t& index) const;
+
+    // The monotone function with index k in that order; false past the last
+    // one or without a store.
+    bool getMonotoneFunction(uint64_t k, uint64_t& functionNumber) const;
+
+    // Same position for any n <= MAX_RANKING_SIZE, counted instead of looked
+    // up or enumerated; false when the function is not monotone. Alpha = 1
+    // uses the ranking tables, built on first use (about 20 s at n = 7);
+    // other orientations up to n = MAX_PACKED_SIZE split into cofactor
+    // intervals as countInterval does, and are refused at n = 7.
+    bool rankMonotone(widenum_t functionNumber, uint64_t& k);
+
+    // The monotone function of position k, false past the last one or for a
+    // refused orientation; a uniform random k < getMonotoneCount() samples
+    // monotone functions uniformly.
+    bool unrankMonotone(uint64_t k, widenum_t& functionNumber);
+
+    // Number of monotone functions of the current n <= MAX_RANKING_SIZE.
+    uint64_t getMonotoneCount();
+
+    // Monotone functions h with lower <= h <= upper pointwise, n <= MAX_PACKED_SIZE.
+    // The bounds need not be monotone, lower is raised to the smallest monotone
+    // function above it and upper lowered to the largest one below it. Splits
+    // on x1 and recurses on the cofactor intervals; an empty one is seen from
+    // one AND, and counts of the cofactor intervals are kept until the next
+    // changeVectorSpaceSize.
+    uint64_t countInterval(uint64_t lower, uint64_t upper);
+
+    // Same interval, every function in increasing order.
+    void enumerateInterval(uint64_t lower, uint64_t upper, const std::function<void(uint64_t)>& visit) const;
+
+    // Calls visit for every monotone function number in [first, last], in order.
+    // The bound is inclusive so the whole n=7 space can be given exactly.
+    // Up to n = MAX_PACKED_SIZE, blocks whose fixed high bits already break
+    // monotonicity are skipped without checking a single number in them.
+    void enumerateMonotone(widenum_t first, widenum_t last, const std::function<void(widenum_t)>& visit) const;
+
+    // The same numbers pulled in batches of batchSize, see MonotoneGenerator.
+    MonotoneGenerator monotoneFunctions(widenum_t first, widenum_t last, std::size_t batchSize = 4096) const;
+
+    // Least function number among f and its relabelings, f with its variables
+    // permuted, for n <= MAX_PACKED_SIZE; orbitSize, when given, receives how
+    // many distinct functions the relabelings give. Walks all n! orders with
+    // one adjacent variable swap, a delta swap on the number, per order.
+    uint64_t canonicalize(uint64_t functionNumber, uint64_t* orbitSize = nullptr) const;
+
+    // visit(f, orbitSize) for the monotone f in [first, last] that are their
+    // own canonical form, in order; with alpha = 1 the orbit sizes add up to
+    // all monotone functions.
+    void enumerateCanonicalMonotone(widenum_t first, widenum_t last, const std::function<void(uint64_t, uint64_t)>& visit) const;
+
+    // Every histogram of MonotoneStatistics from one enumeration, n <= MAX_PACKED_SIZE.
+    // [first, last] is cut into at most chunkCount equal chunks that threads
+    // (all cores for 0) take in turn, each filling its own histograms; those
+    // are merged at the end.
+    MonotoneStatistics collectStatistics(widenum_t first, widenum_t last, std::size_t chunkCount = 256, unsigned threads = 0) const;
+
+    // Tier of the vectorized routines in use, the best one of this CPU by
+    // default; a higher level than the CPU supports binds its best one.
+    void setCpuLevel(CpuLevel level) { mKernels = &getKernels(level); }
+
+    CpuLevel getCpuLevel() const { return mKernels->level; }
+
+    Engine getFastestEngine() const;
+
     std::vector<int8_t> useQuickTransformation(std::vector<uint8_t> f, bool inverse);
 
-    const bignum_t getTotalFunctionsCount() const;
+    int getVectorSpaceSize() const;
+
+    // alpha as given to changeVectorSpaceSize, all ones by default
+    const std::vector<int>& getAlphaSet() const { return m_alphaSet; }
+
+    // 2^(2^n), exact up to n = 6; 0 beyond, where it does not fit (see getLastFunctionNumber)
+    widenum_t getTotalFunctionsCount() const;
+
+    // 2^(2^n) - 1, exact up to n = MAX_NUMBER_SIZE
+    widenum_t getLastFunctionNumber() const;
 
    private:
     std::vector<uint8_t> getLogicalFunction(std::size_t functionNumber);
 
-    const bignum_t getMaxSetsCount() const;
+    // the quick transform criterion, never the store
+    bool calculateTransform(std::size_t functionNumber, bool debug);
+
+    bignum_t getMaxSetsCount() const;
+
+    void preparePackedEngine();
+
+    bool usePrecomputation();
+
+    void prepareMonotoneTable();
+
+    void preparePermutations();
+
+    void prepareTransitionMatrices();
+
+    void printTransitionMatrices() const;
+
+    std::string getPrecomputationPath() const;
+
+    bool loadPrecomputation();
+
+    bool savePrecomputation() const;
+
+    bool isCanonical(uint64_t functionNumber, uint64_t& orbitSize) const;
+
+    void addStatistics(const uint64_t* functions, std::size_t count, std::size_t chunk, MonotoneStatistics& statistics) const;
+
+    bool checkPacked(uint64_t functionNumber) const;
+
+    bool checkTable(uint64_t functionNumber) const;
+
+    bool prefixFails(uint64_t functionNumber, int lowBits) const;
+
+    // both stop as soon as visit returns false
+    void enumerateMonotoneWhile(widenum_t first, widenum_t last, const std::function<bool(widenum_t)>& visit) const;
+
+    bool enumerateBlock(uint64_t start, int bits, widenum_t first, widenum_t last, const std::function<bool(widenum_t)>& visit) const;
+
+    void restrictUnateness(uint64_t f, Unateness& unateness) const;
+
+    void tightenInterval(uint64_t& lower, uint64_t& upper) const;
+
+    void enumerateIntervalBlock(int size, uint64_t lower, uint64_t upper, const std::function<void(uint64_t)>& visit) const;
+
+    uint64_t countIntervalBlock(int size, uint64_t lower, uint64_t upper);
+
+    void openStore();
+
+    // Monotone functions of the interval below bound in function-number
+    // order, and the k-th of them; the interval as in countIntervalBlock.
+    uint64_t countBelowBlock(int size, uint64_t lower, uint64_t upper, uint64_t bound);
+
+    uint64_t selectBlock(int size, uint64_t lower, uint64_t upper, uint64_t k);
 
     int mVectorSpaceSize;
-    int* m_alphaSet;
+    std::vector<int> m_alphaSet;
+    bool mVerbose;
+
+    // function number bits of the current n
+    uint64_t mFunctionMask;
+    // per bit of the input vector: function number bits where that input bit is 1
+    uint64_t mCofactorMasks[MAX_PACKED_SIZE];
+    bool mIncreasing[MAX_VECTOR_SPACE_SIZE];
+    bool mHighDecreasing;
+    // the same masks for the routines of mKernels
+    PackedCheck mPackedCheck;
+    const Kernels* mKernels;
+
+    // what changeVectorSpaceSize builds for one n and alpha besides the masks
+    struct Precomputation {
+        int size;
+        std::vector<int> alpha;
+        std::vector<uint64_t> monotoneTable;
+        // adjacent variable swaps b <-> b + 1 visiting all n! orders, and their masks
+        std::vector<uint8_t> permutationSteps;
+        uint64_t swapMasks[MAX_PACKED_SIZE];
+        uint64_t permutationCount;
+        // per cofactor size below n: lower:upper -> countIntervalBlock
+        std::unordered_map<uint64_t, uint64_t> intervalCounts[MAX_PACKED_SIZE];
+        Eigen::MatrixXf transitionMatrix;
+        Eigen::MatrixXf transitionMatrixInverse;
+    };
+
+    // most recently used first, mTables is the front one
+    std::list<Precomputation> mCache;
+    std::size_t mCacheCapacity = DEFAULT_CACHE_CAPACITY;
+    Precomputation* mTables;
+
+    std::string mCacheDirectory;
+    std::string mStoreDirectory;
+    MonotoneStore mStore;
+    MonotoneRanking mRanking;
 
-    Eigen::MatrixXf mTransitionMatrix;
-    Eigen::MatrixXf mTransitionMatrixInverse;
 };
 
 #endif
\ No newline at end of file
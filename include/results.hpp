@@ -0,0 +1,124 @@
+#ifndef RESULTS_HPP
+#define RESULTS_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <truthtable.hpp>
+
+// One sweep's results in a binary file ("results file") that qmf, cltest and
+// qmfread write and read:
+//
+//   header   magic "QMFRESLT", version, n, alpha
+//   blocks   type, record count, payload size, CRC-32 of the payload, payload
+//   index    per function block: file offset, functions before it, first number
+//   footer   index position and size, function count, index CRC, "QMFINDEX"
+//
+// Function blocks hold up to BLOCK_FUNCTIONS sorted numbers, the first one
+// whole and the rest as gaps, all as LEB128 varints, so every block decodes on
+// its own and a seek binary searches the index. Chunk blocks hold
+// (offset, length, count) records as varints, the last block key/value run
+// metadata. Native byte order, like the store.
+
+struct ChunkRecord {
+    widenum_t offset;
+    widenum_t end;
+    uint64_t count;
+};
+
+class ResultWriter {
+public:
+    static const uint32_t BLOCK_FUNCTIONS = 4096;
+
+    ResultWriter() = default;
+    ~ResultWriter();
+
+    ResultWriter(const ResultWriter&) = delete;
+    ResultWriter& operator=(const ResultWriter&) = delete;
+
+    // Starts path.tmp, renamed to path by close.
+    bool open(const std::string& path, int size, const std::vector<int>& alpha);
+
+    // Numbers must increase, false otherwise or on I/O errors.
+    bool addFunction(widenum_t functionNumber);
+
+    bool addChunk(widenum_t offset, widenum_t end, uint64_t count);
+
+    // Written with the index, a repeated key keeps the last value.
+    void setMetadata(const std::string& key, const std::string& value);
+
+    // Flushes the open blocks and writes metadata, index and footer; false
+    // when anything failed since open, the file is then removed.
+    bool close();
+
+    bool isOpen() const { return mFile != nullptr; }
+
+private:
+    bool flushFunctions();
+
+    bool flushChunks();
+
+    bool writeBlock(uint32_t type, uint32_t count, const std::string& payload);
+
+    FILE* mFile = nullptr;
+    std::string mPath;
+    bool mFailed = false;
+    uint64_t mOffset = 0;
+    uint64_t mFunctionCount = 0;
+    widenum_t mLast = 0;
+
+    std::vector<widenum_t> mFunctions;
+    std::vector<ChunkRecord> mChunks;
+    std::vector<std::pair<std::string, std::string>> mMetadata;
+    std::vector<uint64_t> mIndex; // offset, functions before, first low, first high per block
+};
+
+class ResultReader {
+public:
+    ResultReader() = default;
+    ~ResultReader();
+
+    ResultReader(const ResultReader&) = delete;
+    ResultReader& operator=(const ResultReader&) = delete;
+
+    // Maps the file and reads header, index, chunks and metadata; false when
+    // it is no results file or any of those fails its checksum.
+    bool open(const std::string& path);
+
+    void close();
+
+    int size() const { return mSize; }
+
+    const std::vector<int>& alpha() const { return mAlpha; }
+
+    // functions stored, the index knows without decoding a block
+    uint64_t count() const { return mFunctionCount; }
+
+    const std::vector<ChunkRecord>& chunks() const { return mChunks; }
+
+    const std::vector<std::pair<std::string, std::string>>& metadata() const { return mMetadata; }
+
+    // Calls visit for every stored number in [first, last] in order, starting
+    // at the block the index points to; false on a corrupt block.
+    bool readFunctions(widenum_t first, widenum_t last, const std::function<void(widenum_t)>& visit) const;
+
+    // Checks the CRC of every block.
+    bool verify() const;
+
+private:
+    const unsigned char* mData = nullptr;
+    std::size_t mFileSize = 0;
+    int mSize = 0;
+    std::vector<int> mAlpha;
+    uint64_t mFunctionCount = 0;
+    uint64_t mBlocksEnd = 0;
+    std::vector<uint64_t> mIndex;
+    std::vector<ChunkRecord> mChunks;
+    std::vector<std::pair<std::string, std::string>> mMetadata;
+};
+
+#endif
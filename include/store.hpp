@@ -0,0 +1,55 @@
+#ifndef STORE_HPP
+#define STORE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Sorted function numbers of every monotone function of one n <= 6 and one
+// orientation, memory-mapped from a file written by MonotoneStore::write.
+// The file is a fixed header, a sparse index holding every INDEX_STRIDE-th
+// number, then all numbers in increasing order; a lookup binary searches the
+// index, which stays in cache, and then one stride of the list.
+class MonotoneStore {
+public:
+    static const uint32_t INDEX_STRIDE = 256;
+
+    MonotoneStore() = default;
+    ~MonotoneStore();
+
+    MonotoneStore(const MonotoneStore&) = delete;
+    MonotoneStore& operator=(const MonotoneStore&) = delete;
+
+    // "monotone-<n>-<alpha digits>.qms", alpha as given to changeVectorSpaceSize
+    static std::string getFileName(int size, const std::vector<int>& alpha);
+
+    // Writes the store of the given sorted numbers, false on I/O errors.
+    static bool write(const std::string& path, int size, const std::vector<int>& alpha, const std::vector<uint64_t>& numbers);
+
+    // Maps the file, false when it is missing, truncated or for another n or alpha.
+    bool open(const std::string& path, int size, const std::vector<int>& alpha);
+
+    void close();
+
+    bool isOpen() const { return mNumbers != nullptr; }
+
+    uint64_t count() const { return mCount; }
+
+    bool contains(uint64_t functionNumber) const;
+
+    // monotone functions below functionNumber, its index when it is monotone
+    uint64_t rank(uint64_t functionNumber) const;
+
+    // the monotone function with k monotone functions below it, k < count()
+    uint64_t select(uint64_t k) const { return mNumbers[k]; }
+
+private:
+    void* mData = nullptr;
+    std::size_t mSize = 0;
+    const uint64_t* mIndex = nullptr;
+    const uint64_t* mNumbers = nullptr;
+    uint64_t mIndexCount = 0;
+    uint64_t mCount = 0;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef TRUTHTABLE_HPP
+#define TRUTHTABLE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// function numbers up to n = 7
+typedef unsigned __int128 widenum_t;
+
+// largest n whose function numbers fit into widenum_t
+const int MAX_NUMBER_SIZE = 7;
+
+// Packed truth table of any width. Bit p of the function number, counted from
+// the least significant end, holds f(2^n - 1 - p) and lives in bit p % 64 of
+// word p / 64. For n <= 6 word 0 is exactly the function number.
+class TruthTable {
+public:
+    explicit TruthTable(int size = 0);
+
+    static TruthTable fromNumber(widenum_t number, int size);
+
+    // decimal function number or 0x-prefixed hex string, most significant
+    // digit first; fails when the value needs more than 2^size bits
+    static bool parse(const std::string& text, int size, TruthTable& table);
+
+    int size() const { return mSize; }
+
+    std::size_t bitCount() const { return (std::size_t)1 << mSize; }
+
+    std::size_t wordCount() const { return mWords.size(); }
+
+    const uint64_t* words() const { return mWords.data(); }
+
+    uint64_t* words() { return mWords.data(); }
+
+    bool get(std::size_t position) const { return (mWords[position / 64] >> (position % 64)) & 1; }
+
+    widenum_t toNumber() const;
+
+    std::string toHex() const;
+
+    // decimal when the function number fits into widenum_t, hex otherwise
+    std::string toString() const;
+
+    bool operator==(const TruthTable& other) const { return mSize == other.mSize && mWords == other.mWords; }
+
+private:
+    int mSize;
+    std::vector<uint64_t> mWords;
+};
+
+std::string toString(widenum_t value);
+
+bool parseNumber(const std::string& text, widenum_t& value);
+
+#endif
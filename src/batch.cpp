@@ -0,0 +1,529 @@
+#include <batch.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// smallest slice worth handing to a separate thread
+const std::size_t MIN_THREAD_QUERIES = 1 << 14;
+
+// output is flushed once this much is pending
+const std::size_t OUTPUT_BUFFER_SIZE = 1 << 20;
+
+struct Input {
+    const char* data = nullptr;
+    std::size_t size = 0;
+    bool mapped = false;
+    std::string buffer;
+};
+
+static bool openInput(const char* path, Input& input) {
+    if (std::strcmp(path, "-") == 0) {
+        char block[1 << 16];
+        ssize_t n;
+
+        while ((n = read(0, block, sizeof(block))) > 0) {
+            input.buffer.append(block, n);
+        }
+
+        input.data = input.buffer.data();
+        input.size = input.buffer.size();
+        return n == 0;
+    }
+
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) return false;
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+
+    input.size = st.st_size;
+
+    if (input.size > 0) {
+        void* data = mmap(nullptr, input.size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (data == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+
+        madvise(data, input.size, MADV_SEQUENTIAL);
+
+        input.data = static_cast<const char*>(data);
+        input.mapped = true;
+    }
+
+    close(fd);
+    return true;
+}
+
+static void closeInput(Input& input) {
+    if (input.mapped) munmap(const_cast<char*>(input.data), input.size);
+}
+
+class Output {
+public:
+    ~Output() { flush(); }
+
+    void write(const char* s, std::size_t n) {
+        mBuffer.append(s, n);
+
+        if (mBuffer.size() >= OUTPUT_BUFFER_SIZE) flush();
+    }
+
+    void write(const std::string& s) { write(s.data(), s.size()); }
+
+    void writeNumber(widenum_t value) {
+        char digits[40];
+        int n = 0;
+
+        do {
+            digits[n++] = '0' + value % 10;
+            value /= 10;
+        } while (value);
+
+        while (n) mBuffer.push_back(digits[--n]);
+
+        mBuffer.push_back('\n');
+
+        if (mBuffer.size() >= OUTPUT_BUFFER_SIZE) flush();
+    }
+
+    void flush() {
+        fwrite(mBuffer.data(), 1, mBuffer.size(), stdout);
+        mBuffer.clear();
+    }
+
+private:
+    std::string mBuffer;
+};
+
+// splits the queries over all cores, slices are word aligned so every
+// thread writes its own part of the bitmap
+static void evaluate(const Executor* executor, const std::vector<uint64_t>& numbers, std::vector<uint64_t>& bitmap) {
+    std::size_t count = numbers.size();
+
+    bitmap.resize((count + 63) / 64);
+
+    std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+
+    threads = std::min(threads, std::max<std::size_t>(1, count / MIN_THREAD_QUERIES));
+
+    std::size_t slice = ((count + threads - 1) / threads + 63) / 64 * 64;
+
+    std::vector<std::thread> workers;
+
+    for (std::size_t begin = slice; begin < count; begin += slice) {
+        std::size_t n = std::min(slice, count - begin);
+
+        workers.emplace_back([=, &numbers, &bitmap] {
+            executor->calculateMonotonicityBatch(numbers.data() + begin, n, bitmap.data() + begin / 64);
+        });
+    }
+
+    executor->calculateMonotonicityBatch(numbers.data(), std::min(slice, count), bitmap.data());
+
+    for (auto& worker : workers) worker.join();
+}
+
+static void answer(const Executor* executor, std::vector<uint64_t>& numbers, Output& out) {
+    if (numbers.empty()) return;
+
+    std::vector<uint64_t> bitmap;
+
+    evaluate(executor, numbers, bitmap);
+
+    for (std::size_t i = 0; i < numbers.size(); i++) {
+        if ((bitmap[i / 64] >> (i % 64)) & 1)
+            out.write("Yes\n", 4);
+        else
+            out.write("No\n", 3);
+    }
+
+    numbers.clear();
+}
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// "@n [alpha_1 ... alpha_n]", same layout as the interactive command
+static bool parseConfiguration(const char* p, const char* end, int& size, std::vector<int>& alpha) {
+    std::vector<int> values;
+
+    while (p < end) {
+        while (p < end && isSpace(*p)) p++;
+
+        if (p == end) break;
+
+        if (*p < '0' || *p > '9') return false;
+
+        int value = 0;
+
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (value > MAX_VECTOR_SPACE_SIZE) return false;
+
+            value = value * 10 + (*p++ - '0');
+        }
+
+        values.push_back(value);
+    }
+
+    if (values.empty() || values[0] > MAX_VECTOR_SPACE_SIZE) return false;
+
+    size = values[0];
+    alpha.assign(values.begin() + 1, values.end());
+
+    return alpha.empty() || (int)alpha.size() == size;
+}
+
+bool parseInterval(const std::string& text, int size, uint64_t& lower, uint64_t& upper) {
+    if (size > MAX_PACKED_SIZE || text.size() < 2 || text.front() != '[' || text.back() != ']') return false;
+
+    std::string bounds = text.substr(1, text.size() - 2);
+
+    std::replace(bounds.begin(), bounds.end(), ',', ' ');
+
+    std::stringstream ss(bounds);
+    std::string first, second, rest;
+    TruthTable lowerTable, upperTable;
+
+    if (!(ss >> first >> second) || (ss >> rest)) return false;
+
+    if (!TruthTable::parse(first, size, lowerTable) || !TruthTable::parse(second, size, upperTable)) return false;
+
+    lower = lowerTable.words()[0];
+    upper = upperTable.words()[0];
+
+    return true;
+}
+
+bool writeMonotoneList(Executor* executor, const std::string& path, uint64_t& count) {
+    ResultWriter writer;
+    if (!writer.open(path, executor->getVectorSpaceSize(), executor->getAlphaSet())) return false;
+
+    count = 0;
+
+    executor->enumerateMonotone(0, executor->getLastFunctionNumber(), [&](widenum_t f) {
+        writer.addFunction(f);
+        count++;
+    });
+
+    writer.setMetadata("program", "qmf");
+    writer.setMetadata("count", std::to_string(count));
+
+    return writer.close();
+}
+
+std::string formatStatistics(const MonotoneStatistics& statistics) {
+    std::string text = "Monotonic functions count for given vector space: " + std::to_string(statistics.total) + "\n";
+
+    auto section = [&](const char* header, const std::vector<uint64_t>& counts) {
+        text += header;
+
+        for (std::size_t i = 0; i < counts.size(); i++) text += std::to_string(i) + "," + std::to_string(counts[i]) + "\n";
+    };
+
+    section("weight,count\n", statistics.byWeight);
+    section("minimal_terms,count\n", statistics.byMinimalTerms);
+    section("degree,count\n", statistics.byDegree);
+
+    text += "offset,count\n";
+
+    for (std::size_t i = 0; i < statistics.byChunk.size(); i++)
+        text += toString(statistics.first + i * statistics.chunkSize) + "," + std::to_string(statistics.byChunk[i]) + "\n";
+
+    return text;
+}
+
+// the stored functions are queries under the n and alpha of the file
+static int answerResults(Executor* executor, const ResultReader& reader) {
+    std::vector<int> alpha = reader.alpha();
+    Output out;
+    std::vector<uint64_t> numbers;
+
+    executor->changeVectorSpaceSize(reader.size(), alpha.data());
+
+    bool read = reader.readFunctions(0, ~(widenum_t)0, [&](widenum_t f) {
+        if (reader.size() > MAX_PACKED_SIZE) {
+            bool monotone = executor->calculateMonotonicity(TruthTable::fromNumber(f, reader.size()));
+
+            out.write(monotone ? "Yes\n" : "No\n", monotone ? 4 : 3);
+            return;
+        }
+
+        numbers.push_back((uint64_t)f);
+
+        if (numbers.size() == QUERY_WINDOW) answer(executor, numbers, out);
+    });
+
+    answer(executor, numbers, out);
+
+    if (!read) {
+        out.flush();
+        fprintf(stderr, "qmf: corrupt function block in results file\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+int runBatch(Executor* executor, const char* path) {
+    if (std::strcmp(path, "-") != 0) {
+        ResultReader reader;
+
+        if (reader.open(path)) return answerResults(executor, reader);
+    }
+
+    Input input;
+
+    if (!openInput(path, input)) {
+        fprintf(stderr, "qmf: cannot read %s\n", path);
+        return 1;
+    }
+
+    Output out;
+    std::vector<uint64_t> numbers;
+    numbers.reserve(QUERY_WINDOW);
+
+    const char* p = input.data;
+    const char* end = input.data + input.size;
+    std::size_t lineNumber = 0;
+    int status = 0;
+
+    while (p < end) {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+
+        if (eol == nullptr) eol = end;
+
+        const char* line = p;
+        const char* lineEnd = eol;
+
+        p = eol + 1;
+        lineNumber++;
+
+        while (line < lineEnd && isSpace(*line)) line++;
+        while (lineEnd > line && isSpace(lineEnd[-1])) lineEnd--;
+
+        if (line == lineEnd) continue;
+
+        if (*line >= '0' && *line <= '9') {
+            int n = executor->getVectorSpaceSize();
+            uint64_t value = 0;
+            const char* q = line;
+
+            bool overflow = false;
+
+            // plain decimals of the current n skip building a table, they
+            // parse to the same number
+            while (q < lineEnd && *q >= '0' && *q <= '9') {
+                overflow |= __builtin_mul_overflow(value, 10, &value);
+                overflow |= __builtin_add_overflow(value, *q++ - '0', &value);
+            }
+
+            if (q == lineEnd && !overflow && n <= MAX_PACKED_SIZE && (n == MAX_PACKED_SIZE || value >> (1 << n) == 0)) {
+                numbers.push_back(value);
+
+                if (numbers.size() == QUERY_WINDOW) answer(executor, numbers, out);
+
+                continue;
+            }
+
+            // as in the REPL: 0x tables, 128-bit numbers and every n
+            TruthTable table;
+
+            if (!TruthTable::parse(std::string(line, lineEnd), n, table)) {
+                fprintf(stderr, "qmf: line %zu: invalid function number\n", lineNumber);
+                status = 1;
+                break;
+            }
+
+            if (n <= MAX_PACKED_SIZE) {
+                numbers.push_back(table.words()[0]);
+
+                if (numbers.size() == QUERY_WINDOW) answer(executor, numbers, out);
+
+                continue;
+            }
+
+            // only n <= 6 is batched, so nothing is queued here
+            bool monotone = executor->calculateMonotonicity(table);
+
+            out.write(monotone ? "Yes\n" : "No\n", monotone ? 4 : 3);
+            continue;
+        }
+
+        // directives apply in order, so answer everything queued before them
+        answer(executor, numbers, out);
+
+        std::string directive(line, lineEnd);
+
+        if (directive == "exit") break;
+
+        if (directive == "#") continue; // debug output is interactive only
+
+        if (directive[0] == '@') {
+            int size = 0;
+            std::vector<int> alpha;
+
+            if (!parseConfiguration(line + 1, lineEnd, size, alpha)) {
+                fprintf(stderr, "qmf: line %zu: invalid configuration\n", lineNumber);
+                status = 1;
+                break;
+            }
+
+            executor->changeVectorSpaceSize(size, alpha.empty() ? nullptr : alpha.data());
+            continue;
+        }
+
+        if (directive == "?$") {
+            if (executor->getVectorSpaceSize() > MAX_UNATE_COUNT_SIZE) {
+                fprintf(stderr, "qmf: line %zu: unate functions are only counted up to n = %d\n", lineNumber, MAX_UNATE_COUNT_SIZE);
+                status = 1;
+                break;
+            }
+
+            out.write("Unate functions count for given vector space: " + std::to_string(executor->countUnateFunctions()) + "\n");
+            continue;
+        }
+
+        if (directive[0] == '?') {
+            TruthTable table;
+
+            if (!TruthTable::parse(directive.substr(1), executor->getVectorSpaceSize(), table)) {
+                fprintf(stderr, "qmf: line %zu: invalid function\n", lineNumber);
+                status = 1;
+                break;
+            }
+
+            out.write(toString(executor->calculateUnateness(table), executor->getVectorSpaceSize()) + "\n");
+            continue;
+        }
+
+        if (directive[0] == '=') {
+            TruthTable table;
+            int n = executor->getVectorSpaceSize();
+
+            if (n > MAX_PACKED_SIZE || !TruthTable::parse(directive.substr(1), n, table)) {
+                fprintf(stderr, "qmf: line %zu: invalid function, expected =f with n <= %d\n", lineNumber, MAX_PACKED_SIZE);
+                status = 1;
+                break;
+            }
+
+            uint64_t orbitSize = 0;
+            uint64_t canonical = executor->canonicalize((uint64_t)table.toNumber(), &orbitSize);
+
+            out.write(std::to_string(canonical) + " " + std::to_string(orbitSize) + "\n");
+            continue;
+        }
+
+        if (directive == "$=") {
+            if (executor->getVectorSpaceSize() > MAX_PACKED_SIZE) {
+                fprintf(stderr, "qmf: line %zu: canonical functions are only listed up to n = %d\n", lineNumber, MAX_PACKED_SIZE);
+                status = 1;
+                break;
+            }
+
+            uint64_t canonicalCount = 0;
+
+            executor->enumerateCanonicalMonotone(0, executor->getLastFunctionNumber(), [&](uint64_t f, uint64_t orbitSize) {
+                canonicalCount++;
+                out.write(std::to_string(f) + " " + std::to_string(orbitSize) + "\n");
+            });
+
+            out.write("Canonical monotonic functions count: " + std::to_string(canonicalCount) + "\n");
+            continue;
+        }
+
+        if (directive[0] == '[' || directive.compare(0, 2, "$[") == 0) {
+            bool list = directive[0] == '$';
+            uint64_t lower = 0, upper = 0;
+
+            if (!parseInterval(directive.substr(list ? 1 : 0), executor->getVectorSpaceSize(), lower, upper)) {
+                fprintf(stderr, "qmf: line %zu: invalid interval, expected [f g] with n <= %d\n", lineNumber, MAX_PACKED_SIZE);
+                status = 1;
+                break;
+            }
+
+            if (list) executor->enumerateInterval(lower, upper, [&](uint64_t h) { out.writeNumber(h); });
+
+            out.write("Monotone functions in the interval: " + std::to_string(executor->countInterval(lower, upper)) + "\n");
+            continue;
+        }
+
+        if (directive.compare(0, 2, "$>") == 0) {
+            uint64_t count = 0;
+            std::string target = directive.substr(2);
+
+            target.erase(0, target.find_first_not_of(" \t"));
+
+            if (executor->getVectorSpaceSize() > MAX_PACKED_SIZE) {
+                fprintf(stderr, "qmf: line %zu: monotone functions are only listed up to n = %d\n", lineNumber, MAX_PACKED_SIZE);
+                status = 1;
+                break;
+            }
+
+            if (!writeMonotoneList(executor, target, count)) {
+                fprintf(stderr, "qmf: line %zu: cannot write %s\n", lineNumber, target.c_str());
+                status = 1;
+                break;
+            }
+
+            out.write("Monotonic functions count for given vector space: " + std::to_string(count) + "\n");
+            continue;
+        }
+
+        if (directive == "$%") {
+            if (executor->getVectorSpaceSize() > MAX_PACKED_SIZE) {
+                fprintf(stderr, "qmf: line %zu: statistics are only collected up to n = %d\n", lineNumber, MAX_PACKED_SIZE);
+                status = 1;
+                break;
+            }
+
+            out.write(formatStatistics(executor->collectStatistics(0, executor->getLastFunctionNumber())));
+            continue;
+        }
+
+        if (directive == "$") {
+            if (executor->getVectorSpaceSize() > MAX_PACKED_SIZE) {
+                fprintf(stderr, "qmf: line %zu: monotone functions are only listed up to n = %d\n", lineNumber, MAX_PACKED_SIZE);
+                status = 1;
+                break;
+            }
+
+            std::size_t monotonicCount = 0;
+
+            executor->enumerateMonotone(0, executor->getLastFunctionNumber(), [&](widenum_t f) {
+                monotonicCount++;
+                out.writeNumber(f);
+            });
+
+            out.write("Monotonic functions count for given vector space: " + std::to_string(monotonicCount) + "\n");
+            continue;
+        }
+
+        fprintf(stderr, "qmf: line %zu: unknown command\n", lineNumber);
+        status = 1;
+        break;
+    }
+
+    answer(executor, numbers, out);
+    out.flush();
+    closeInput(input);
+
+    return status;
+}
@@ -4,144 +4,1456 @@
 #else
 #include <CL/cl.h>
 #endif
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <fstream>
+#include <functional>
 #include <cmath>
 #include <climits>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include <cofactors.hpp>
+#include <executor.hpp>
+#include <results.hpp>
+#include <truthtable.hpp>
 
 typedef unsigned long long bignum;
 
-cl_platform_id cpPlatform; // OpenCL platform
-cl_device_id device_id;    // device ID
-cl_context context;        // context
-cl_command_queue queue;    // command queue
-cl_program program;        // program
-cl_kernel kernel;          // kernel
-cl_mem d_N;
-cl_mem d_hist;
+struct Device
+{
+    cl_platform_id platform;
+    cl_device_id id;
+    cl_device_type type;
+    std::string platformName;
+    std::string name;
+};
+
+cl_platform_id cpPlatform; // OpenCL platform
+cl_device_id device_id;    // device ID
+cl_context context;        // context
+cl_command_queue queue;    // command queue
+cl_program program;        // program
+cl_kernel kernel;          // kernel
+
+std::size_t localSize = 32;
+
+// function numbers per work-item, only kernels taking a block size (kernel_p.cl)
+cl_uint block = 1;
+bool blockedKernel = false;
+
+// Per-chunk counters stay on the device in two banks of CHUNK_SLOTS: kernels
+// fill one bank while the other one is read back, so the host only touches
+// the device once per window instead of once per chunk.
+const int CHUNK_SLOTS = 256;
+
+// kernels queued ahead of the oldest unfinished one
+const std::size_t CHUNKS_IN_FLIGHT = 4;
+
+struct Window
+{
+    widenum_t first = 0; // offset of the first chunk counted in the bank
+    int chunks = 0;
+    cl_ulong hitCount = 0;
+    std::vector<widenum_t> ends;   // where every chunk of the bank ends
+    std::vector<cl_event> kernels; // one per chunk, NULL where it was pruned on the host
+    cl_event countsRead = NULL;    // read back of chunkResult
+    cl_event read = NULL;          // read back of hitCount, after countsRead
+    cl_event resultReset = NULL;   // zeroing of chunkResult after the read
+    cl_event reset = NULL;         // zeroing of hitCount, the next kernels wait on it
+};
+
+cl_mem d_result[2];
+cl_ulong chunkResult[2][CHUNK_SLOTS];
+Window windows[2];
+
+bignum result;
+
+// Functions counted in finished chunks. Chunks are only added when they start
+// exactly where the previous one ended, so reaching 2^(2^N) proves that every
+// function number was checked once; n = 6 needs the 128-bit type for that.
+widenum_t covered = 0;
+bool gapFound = false;
+
+// Ranges skipped on the host because their fixed high bits already break
+// monotonicity; they still take a slot and are logged as chunks with 0.
+bool pruning = true;
+widenum_t prunedFunctions = 0;
+bignum prunedChunks = 0;
+
+// Every hit is appended to its bank's list: atom_inc on the bank's hit
+// count reserves the slot, hits past the capacity are counted but not stored.
+// Lists are drained into hitsFile as raw native-endian 64-bit numbers, in no
+// particular order, when the bank's window is finished; --results sorts each
+// window's list into the results file next to the chunk counts.
+cl_uint hitCapacity = 1 << 20;
+cl_mem d_hitCount[2];
+cl_mem d_hits[2];
+std::vector<cl_ulong> hits;
+FILE *hitsFile = NULL;
+ResultWriter results;
+bignum totalHits = 0;
+bool hitsOverflow = false;
+
+// --timing reports every command of a finished window from its profiling
+// timestamps (device nanoseconds): kernels per chunk, transfers per window,
+// and the gaps in which the device had no kernel to run
+bool timing = false;
+std::ofstream timingLog;
+cl_ulong lastKernelEnd = 0;
+cl_ulong kernelTime = 0;
+cl_ulong transferTime = 0;
+cl_ulong gapTime = 0;
+
+struct EventTimes
+{
+    cl_ulong queued = 0;
+    cl_ulong submit = 0;
+    cl_ulong start = 0;
+    cl_ulong end = 0;
+};
+
+EventTimes getEventTimes(cl_event event)
+{
+    EventTimes times;
+
+    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &times.queued, NULL);
+    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_SUBMIT, sizeof(cl_ulong), &times.submit, NULL);
+    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &times.start, NULL);
+    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &times.end, NULL);
+
+    return times;
+}
+
+// one row per command, count is functions for kernels and bytes for transfers
+void logEvent(const char *kind, widenum_t offset, bignum count, const EventTimes &times, cl_ulong gap)
+{
+    if (!timingLog.is_open())
+        return;
+
+    cl_ulong duration = times.end - times.start;
+
+    timingLog << kind << "," << toString(offset) << "," << count << "," << times.queued << "," << times.submit << "," << times.start << ","
+              << times.end << "," << duration << "," << gap << "," << (duration ? count * 1e9 / duration : 0) << "\n";
+}
+
+// logs a transfer and adds it to the totals, returns its device time
+cl_ulong reportTransfer(const char *kind, widenum_t offset, bignum bytes, cl_event event)
+{
+    EventTimes times = getEventTimes(event);
+
+    logEvent(kind, offset, bytes, times, 0);
+    transferTime += times.end - times.start;
+
+    return times.end - times.start;
+}
+
+// Function numbers from offset on that need no kernel, 0 when the count
+// numbers from offset have to run. Grows the skip to the largest aligned
+// block around offset that still fails, which may span many chunks.
+widenum_t getPrunedCount(widenum_t offset, bignum count, widenum_t total, int n, int decreasing)
+{
+    widenum_t last = offset + count - 1;
+    int bits = 0;
+
+    while ((offset >> bits) != (last >> bits))
+        bits++;
+
+    if (bits >= (1 << n) || !prefixFails((bignum)offset, n, decreasing, bits))
+        return 0;
+
+    while (bits + 1 < (1 << n) && prefixFails((bignum)offset, n, decreasing, bits + 1))
+        bits++;
+
+    return std::min(((offset >> bits) + 1) << bits, total) - offset;
+}
+
+// checks count function numbers from offset; the last chunk may be shorter
+cl_int enqueueChunk(bignum offset, bignum count, int bank, int slot, cl_event *event)
+{
+    cl_ulong offsetArg = offset;
+    cl_ulong countArg = count;
+    cl_uint slotArg = slot;
+    cl_uint capacityArg = hitsFile || results.isOpen() ? hitCapacity : 0; // count only
+
+    clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_result[bank]);
+    clSetKernelArg(kernel, 1, sizeof(cl_ulong), &offsetArg);
+    clSetKernelArg(kernel, 2, sizeof(cl_ulong), &countArg);
+    clSetKernelArg(kernel, 3, sizeof(cl_mem), &d_hitCount[bank]);
+    clSetKernelArg(kernel, 4, sizeof(cl_mem), &d_hits[bank]);
+    clSetKernelArg(kernel, 5, sizeof(cl_uint), &capacityArg);
+    clSetKernelArg(kernel, 6, sizeof(cl_uint), &slotArg);
+
+    if (blockedKernel)
+    {
+        clSetKernelArg(kernel, 7, sizeof(cl_uint), &block);
+        clSetKernelArg(kernel, 8, sizeof(cl_ulong) * localSize, NULL);
+    }
+
+    // whole work-groups, the kernels ignore items past count
+    std::size_t items = (count + block - 1) / block;
+    std::size_t globalSize = (items + localSize - 1) / localSize * localSize;
+
+    // arguments are captured here, the next chunk may change them right away
+    cl_event *reset = windows[bank].reset ? &windows[bank].reset : NULL;
+
+    return clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &globalSize, &localSize, reset ? 1 : 0, reset, event);
+}
+
+// waits for the bank's read back, prints its chunks, drains its hits and
+// queues the zeroing that the bank's next kernels wait on
+cl_int finishWindow(int bank, widenum_t total)
+{
+    Window &window = windows[bank];
+
+    if (!window.chunks)
+        return CL_SUCCESS;
+
+    cl_int err = clWaitForEvents(1, &window.read);
+
+    if (err)
+        return err;
+
+    for (int i = 0; i < window.chunks; i++)
+    {
+        widenum_t offset = i ? window.ends[i - 1] : window.first;
+        widenum_t end = window.ends[i];
+        double percent = ((double)end / (double)total) * 100;
+
+        std::cout << "Chunk (" << toString(offset) << " , " << toString(end) << ", " << percent << "%) => " << chunkResult[bank][i] << std::endl;
+
+        if (results.isOpen())
+            results.addChunk(offset, end, chunkResult[bank][i]);
+
+        if (timing && window.kernels[i])
+        {
+            EventTimes times = getEventTimes(window.kernels[i]);
+
+            // kernels of one window may overlap, only idle time counts
+            cl_ulong gap = lastKernelEnd && times.start > lastKernelEnd ? times.start - lastKernelEnd : 0;
+            cl_ulong duration = times.end - times.start;
+
+            lastKernelEnd = std::max(lastKernelEnd, times.end);
+            kernelTime += duration;
+            gapTime += gap;
+
+            logEvent("kernel", offset, (bignum)(end - offset), times, gap);
+
+            printf("  kernel %.3f ms, waited %.3f ms in queue, gap %.3f ms, %.4g functions/s\n", duration / 1e6, (times.start - times.queued) / 1e6,
+                   gap / 1e6, duration ? (double)(end - offset) * 1e9 / duration : 0);
+        }
+
+        if (offset != covered)
+            gapFound = true;
+
+        covered = end;
+        result += chunkResult[bank][i];
+    }
+
+    totalHits += window.hitCount;
+
+    cl_ulong windowTransfers = 0;
+
+    if (timing)
+    {
+        windowTransfers += reportTransfer("read-counts", window.first, sizeof(cl_ulong) * window.chunks, window.countsRead);
+        windowTransfers += reportTransfer("read-hit-count", window.first, sizeof(cl_ulong), window.read);
+    }
+
+    if (hitsFile || results.isOpen())
+    {
+        if (window.hitCount > hitCapacity)
+        {
+            std::cout << "Hit list overflow in (" << toString(window.first) << " , " << toString(covered) << "): " << window.hitCount
+                      << " hits, capacity " << hitCapacity << ", see --hit-capacity" << std::endl;
+            hitsOverflow = true;
+        }
+
+        cl_ulong stored = std::min<cl_ulong>(window.hitCount, hitCapacity);
+
+        if (stored)
+        {
+            cl_event hitsRead;
+            err = clEnqueueReadBuffer(queue, d_hits[bank], CL_TRUE, 0, sizeof(cl_ulong) * stored, hits.data(), 0, NULL, &hitsRead);
+
+            if (err)
+                return err;
+
+            if (timing)
+                windowTransfers += reportTransfer("read-hits", window.first, sizeof(cl_ulong) * stored, hitsRead);
+
+            clReleaseEvent(hitsRead);
+
+            if (hitsFile && fwrite(hits.data(), sizeof(cl_ulong), stored, hitsFile) != stored)
+            {
+                printf("Error writing hits\n");
+                hitsOverflow = true;
+            }
+
+            // windows come in order, only the hits within one are unordered
+            if (results.isOpen())
+            {
+                std::sort(hits.begin(), hits.begin() + stored);
+
+                for (cl_ulong i = 0; i < stored; i++)
+                    results.addFunction(hits[i]);
+            }
+        }
+    }
+
+    // the zeroing that prepared this window has long finished
+    if (window.resultReset)
+    {
+        if (timing)
+            windowTransfers += reportTransfer("fill-counts", window.first, sizeof(cl_ulong) * CHUNK_SLOTS, window.resultReset);
+
+        clReleaseEvent(window.resultReset);
+    }
+
+    if (window.reset)
+    {
+        if (timing)
+            windowTransfers += reportTransfer("fill-hit-count", window.first, sizeof(cl_ulong), window.reset);
+
+        clReleaseEvent(window.reset);
+    }
+
+    if (timing)
+        printf("  transfers %.3f ms for %d chunks\n", windowTransfers / 1e6, window.chunks);
+
+    for (auto event : window.kernels)
+    {
+        if (event)
+            clReleaseEvent(event);
+    }
+
+    clReleaseEvent(window.countsRead);
+    clReleaseEvent(window.read);
+    window.kernels.clear();
+    window.ends.clear();
+    window.countsRead = NULL;
+    window.read = NULL;
+
+    cl_ulong zero = 0;
+    err = clEnqueueFillBuffer(queue, d_result[bank], &zero, sizeof(cl_ulong), 0, sizeof(cl_ulong) * window.chunks, 0, NULL, &window.resultReset);
+
+    if (err)
+        return err;
+
+    err = clEnqueueFillBuffer(queue, d_hitCount[bank], &zero, sizeof(cl_ulong), 0, sizeof(cl_ulong), 1, &window.resultReset, &window.reset);
+
+    window.chunks = 0;
+
+    return err;
+}
+
+std::string getPlatformString(cl_platform_id platform, cl_platform_info param)
+{
+    char value[256] = {0};
+    clGetPlatformInfo(platform, param, sizeof(value) - 1, value, NULL);
+    return value;
+}
+
+std::string getDeviceString(cl_device_id device, cl_device_info param)
+{
+    char value[256] = {0};
+    clGetDeviceInfo(device, param, sizeof(value) - 1, value, NULL);
+    return value;
+}
+
+const char *getDeviceTypeName(cl_device_type type)
+{
+    if (type & CL_DEVICE_TYPE_GPU)
+        return "GPU";
+    if (type & CL_DEVICE_TYPE_CPU)
+        return "CPU";
+    if (type & CL_DEVICE_TYPE_ACCELERATOR)
+        return "accelerator";
+
+    return "other";
+}
+
+// every device of the given type on every platform, in platform order
+std::vector<Device> getDevices(cl_device_type type)
+{
+    std::vector<Device> devices;
+
+    cl_uint platformCount = 0;
+
+    if (clGetPlatformIDs(0, NULL, &platformCount) != CL_SUCCESS || platformCount == 0)
+        return devices;
+
+    std::vector<cl_platform_id> platforms(platformCount);
+    clGetPlatformIDs(platformCount, platforms.data(), NULL);
+
+    for (auto platform : platforms)
+    {
+        cl_uint deviceCount = 0;
+
+        // CL_DEVICE_NOT_FOUND just means this platform has none of that type
+        if (clGetDeviceIDs(platform, type, 0, NULL, &deviceCount) != CL_SUCCESS || deviceCount == 0)
+            continue;
+
+        std::vector<cl_device_id> ids(deviceCount);
+        clGetDeviceIDs(platform, type, deviceCount, ids.data(), NULL);
+
+        for (auto id : ids)
+        {
+            Device device;
+            device.platform = platform;
+            device.id = id;
+            clGetDeviceInfo(id, CL_DEVICE_TYPE, sizeof(device.type), &device.type, NULL);
+            device.platformName = getPlatformString(platform, CL_PLATFORM_NAME);
+            device.name = getDeviceString(id, CL_DEVICE_NAME);
+            devices.push_back(device);
+        }
+    }
+
+    return devices;
+}
+
+// A binary is only valid for the device, driver, build options and source it
+// was built from, so all of them make up the cache key. The key is stored in
+// front of the binary to catch hash collisions.
+std::string getCacheKey(const Device &device, const std::string &source, const std::string &options)
+{
+    return getPlatformString(device.platform, CL_PLATFORM_NAME) + "\n" + getDeviceString(device.id, CL_DEVICE_NAME) + "\n" +
+           getDeviceString(device.id, CL_DRIVER_VERSION) + "\n" + options + "\n" + source;
+}
+
+bool loadCachedBinary(const std::string &path, const std::string &key, std::vector<unsigned char> &binary)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    cl_ulong keySize = 0;
+    cl_ulong binarySize = 0;
+
+    if (!file.read((char *)&keySize, sizeof(keySize)) || keySize != key.size())
+        return false;
+
+    std::string storedKey(keySize, '\0');
+
+    if (!file.read(&storedKey[0], keySize) || storedKey != key)
+        return false;
+
+    if (!file.read((char *)&binarySize, sizeof(binarySize)) || binarySize == 0)
+        return false;
+
+    binary.resize(binarySize);
+
+    return (bool)file.read((char *)binary.data(), binarySize);
+}
+
+void saveCachedBinary(const std::string &path, const std::string &key, cl_program built)
+{
+    std::size_t binarySize = 0;
+
+    if (clGetProgramInfo(built, CL_PROGRAM_BINARY_SIZES, sizeof(binarySize), &binarySize, NULL) || binarySize == 0)
+        return;
+
+    std::vector<unsigned char> binary(binarySize);
+    unsigned char *binaries[] = {binary.data()};
+
+    if (clGetProgramInfo(built, CL_PROGRAM_BINARIES, sizeof(binaries), binaries, NULL))
+        return;
+
+    // written aside and renamed, a concurrent run never sees half a file
+    std::string temporaryPath = path + ".tmp";
+    std::ofstream file(temporaryPath, std::ios::binary);
+
+    cl_ulong keySize = key.size();
+    cl_ulong size = binarySize;
+
+    file.write((const char *)&keySize, sizeof(keySize));
+    file.write(key.data(), key.size());
+    file.write((const char *)&size, sizeof(size));
+    file.write((const char *)binary.data(), binarySize);
+    file.close();
+
+    if (file)
+        std::rename(temporaryPath.c_str(), path.c_str());
+    else
+        std::remove(temporaryPath.c_str());
+}
+
+// builds the kernel for the device, from the cache when it has a binary for
+// exactly this source and these options
+cl_program buildProgram(cl_context deviceContext, const Device &device, const std::string &source, const std::string &options, const std::string &cacheDir)
+{
+    std::string key = getCacheKey(device, source, options);
+    std::string path;
+
+    if (!cacheDir.empty())
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016zx.bin", std::hash<std::string>()(key));
+        path = cacheDir + "/" + name;
+
+        std::vector<unsigned char> binary;
+
+        if (loadCachedBinary(path, key, binary))
+        {
+            const unsigned char *data = binary.data();
+            std::size_t size = binary.size();
+            cl_int status = CL_SUCCESS;
+
+            cl_program cached = clCreateProgramWithBinary(deviceContext, 1, &device.id, &size, &data, &status, NULL);
+
+            if (cached && status == CL_SUCCESS && clBuildProgram(cached, 1, &device.id, options.c_str(), NULL, NULL) == CL_SUCCESS)
+            {
+                printf("Kernel binary: %s\n", path.c_str());
+                return cached;
+            }
+
+            // a driver update can reject old binaries, rebuild and replace them
+            if (cached)
+                clReleaseProgram(cached);
+        }
+    }
+
+    const char *text = source.c_str();
+    cl_program built = clCreateProgramWithSource(deviceContext, 1, &text, NULL, NULL);
+
+    auto buildError = clBuildProgram(built, 1, &device.id, options.c_str(), NULL, NULL);
+
+    if (buildError)
+    {
+        char buildLog[2048] = {0};
+        clGetProgramBuildInfo(built, device.id, CL_PROGRAM_BUILD_LOG, sizeof(buildLog) - 1, buildLog, NULL);
+        printf("Error building program (%d): %s\n", buildError, buildLog);
+        clReleaseProgram(built);
+        return NULL;
+    }
+
+    if (!path.empty())
+    {
+        mkdir(cacheDir.c_str(), 0755);
+        saveCachedBinary(path, key, built);
+    }
+
+    return built;
+}
+
+// Autotuning times every candidate on the same sample: TUNE_SAMPLE function
+// numbers split into TUNE_SLICES slices spread over the space, since the cost
+// per function depends on where it lies (kernel_p.cl skips most of the space
+// near 2^(2^N)).
+const int TUNE_SLICES = 4;
+const bignum TUNE_SAMPLE = 1ULL << 24;
+
+struct TuneConfig
+{
+    std::size_t local = 0;
+    bignum chunk = 0;
+    cl_uint block = 1;
+    double rate = 0; // functions per second
+};
+
+bool isUsable(const TuneConfig &config, std::size_t maxLocal)
+{
+    return config.chunk % config.block == 0 && config.local <= maxLocal && config.local <= config.chunk / config.block;
+}
+
+// functions per second of one configuration, 0 when the device rejects it
+double measureConfig(const TuneConfig &config, widenum_t total)
+{
+    localSize = config.local;
+    block = config.block;
+
+    int slices = total > TUNE_SAMPLE ? TUNE_SLICES : 1;
+    bignum sliceSize = total > TUNE_SAMPLE ? std::max<bignum>(TUNE_SAMPLE / TUNE_SLICES / config.chunk * config.chunk, config.chunk) : (bignum)total;
+
+    // the first launch pays for lazy compilation and allocation
+    if (enqueueChunk(0, std::min<widenum_t>(config.chunk, total), 0, 0, NULL) || clFinish(queue))
+        return 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < slices; i++)
+    {
+        bignum first = (bignum)(total / slices * i / config.chunk * config.chunk);
+
+        for (bignum position = 0; position < sliceSize; position += config.chunk)
+        {
+            if (enqueueChunk(first + position, std::min(config.chunk, sliceSize - position), 0, 0, NULL))
+                return 0;
+        }
+    }
+
+    if (clFinish(queue))
+        return 0;
+
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+    return (double)sliceSize * slices / seconds.count();
+}
+
+void tryConfig(TuneConfig candidate, TuneConfig &best, widenum_t total, std::size_t maxLocal)
+{
+    if (!isUsable(candidate, maxLocal))
+        return;
+
+    candidate.rate = measureConfig(candidate, total);
+
+    printf("block %u, local %zu, chunk %llu: %.4g functions/s\n", candidate.block, candidate.local, candidate.chunk, candidate.rate);
+
+    if (candidate.rate > best.rate)
+        best = candidate;
+}
+
+// One pass of coordinate descent, block size first, then local size, then
+// chunk size; every step keeps the best of the others fixed.
+TuneConfig autotune(TuneConfig best, widenum_t total, std::size_t maxLocal)
+{
+    best.rate = 0;
+    tryConfig(best, best, total, maxLocal);
+
+    if (blockedKernel)
+    {
+        TuneConfig start = best;
+
+        for (cl_uint candidate = 1; candidate <= 4096; candidate *= 4)
+        {
+            TuneConfig config = start;
+            config.block = candidate;
+            config.local = std::min<std::size_t>(config.local, config.chunk / candidate);
+
+            if (candidate != start.block)
+                tryConfig(config, best, total, maxLocal);
+        }
+    }
+
+    TuneConfig start = best;
+
+    for (std::size_t candidate = 8; candidate <= maxLocal; candidate *= 2)
+    {
+        TuneConfig config = start;
+        config.local = candidate;
+
+        if (candidate != start.local)
+            tryConfig(config, best, total, maxLocal);
+    }
+
+    start = best;
+
+    for (int bits = 16; bits <= 28; bits++)
+    {
+        TuneConfig config = start;
+        config.chunk = std::min<widenum_t>(1ULL << bits, total);
+
+        if (config.chunk != start.chunk)
+            tryConfig(config, best, total, maxLocal);
+
+        if (config.chunk == total)
+            break;
+    }
+
+    return best;
+}
+
+// Tuned configurations go to one file per device, one line per kernel and
+// build options, so the same profile serves every N and orientation.
+std::string getProfilePath(const std::string &profileDir, cl_platform_id platform, cl_device_id deviceId)
+{
+    std::string device = getPlatformString(platform, CL_PLATFORM_NAME) + "\n" + getDeviceString(deviceId, CL_DEVICE_NAME) + "\n" +
+                         getDeviceString(deviceId, CL_DRIVER_VERSION);
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016zx.csv", std::hash<std::string>()(device));
+
+    return profileDir + "/" + name;
+}
+
+bool loadProfile(const std::string &path, const std::string &key, TuneConfig &config)
+{
+    std::ifstream file(path);
+    std::string line;
+
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#' || line.compare(0, key.size() + 1, key + ",") != 0)
+            continue;
+
+        std::istringstream fields(line.substr(key.size() + 1));
+        char comma;
+
+        if (fields >> config.local >> comma >> config.chunk >> comma >> config.block >> comma >> config.rate)
+            return config.local > 0 && config.chunk > 0 && config.block > 0;
+    }
+
+    return false;
+}
+
+void saveProfile(const std::string &profileDir, const std::string &key, const TuneConfig &config)
+{
+    std::string path = getProfilePath(profileDir, cpPlatform, device_id);
+    std::vector<std::string> lines;
+
+    std::ifstream existing(path);
+    std::string line;
+
+    while (std::getline(existing, line))
+    {
+        if (line.compare(0, key.size() + 1, key + ",") != 0 && line[0] != '#')
+            lines.push_back(line);
+    }
+
+    existing.close();
+
+    mkdir(profileDir.c_str(), 0755);
+
+    std::ofstream file(path);
+
+    file << "# " << getPlatformString(cpPlatform, CL_PLATFORM_NAME) << " / " << getDeviceString(device_id, CL_DEVICE_NAME) << " / "
+         << getDeviceString(device_id, CL_DRIVER_VERSION) << "\n";
+    file << "# kernel and build options,local,chunk,block,functions per second\n";
+
+    for (auto &kept : lines)
+        file << kept << "\n";
+
+    file << key << "," << config.local << "," << config.chunk << "," << config.block << "," << config.rate << "\n";
+
+    if (file)
+        printf("Profile saved to %s\n", path.c_str());
+}
+
+// --schedule splits one sweep over every matching device and CPU threads at
+// once. Workers pull aligned power-of-two ranges from one queue, each sized
+// to take about SCHEDULE_TARGET seconds at the rate the worker measured on
+// its previous range, and the ranges are merged back in order at the end.
+const double SCHEDULE_TARGET = 0.25;
+const int MIN_RANGE_BITS = 10;
+const int MAX_RANGE_BITS = 36;
+
+struct ScheduleOptions
+{
+    int n = 0;
+    std::string alpha;
+    int decreasing = 0;
+    bool selfDual = false;
+    int cpuThreads = 0;
+    std::string kernelPath;
+    std::string source;
+    std::string buildOptions;
+    std::string cacheDir;
+    std::string profileDir;
+    std::string hitsPath;
+    std::string resultsPath;
+    bool blockGiven = false;
+    std::size_t localGiven = 0;
+};
+
+struct RangeResult
+{
+    widenum_t first;
+    widenum_t end;
+    cl_ulong count;
+    int worker; // -1 for ranges pruned on the host
+};
+
+struct WorkQueue
+{
+    std::mutex mutex;
+    widenum_t next = 0;
+    widenum_t total = 0;
+    int n = 0;
+    int decreasing = 0;
+    std::vector<RangeResult> results;
+
+    // the next range of at most 2^bits numbers, aligned to its size; ranges
+    // pruned on the way are recorded here, false once the space is handed out
+    bool take(int bits, widenum_t &first, widenum_t &end)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        while (next < total)
+        {
+            int size = bits;
+
+            while (size > 0 && (((next >> size) << size) != next || total - next < ((widenum_t)1 << size)))
+                size--;
+
+            widenum_t count = (widenum_t)1 << size;
+            widenum_t pruned = pruning ? getPrunedCount(next, (bignum)count, total, n, decreasing) : 0;
+
+            if (pruned)
+            {
+                results.push_back({next, next + pruned, 0, -1});
+                next += pruned;
+                continue;
+            }
+
+            first = next;
+            end = next + count;
+            next = end;
+
+            return true;
+        }
+
+        return false;
+    }
+
+    void finish(const RangeResult &range)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        results.push_back(range);
+    }
+};
+
+struct WorkerStats
+{
+    std::string name;
+    widenum_t functions = 0;
+    bignum ranges = 0;
+    double seconds = 0;
+    std::vector<cl_ulong> hits;
+    cl_int error = CL_SUCCESS;
+};
+
+// power of two of the range that takes SCHEDULE_TARGET at the given rate
+int getRangeBits(double rate)
+{
+    int bits = (int)std::log2(std::max(rate * SCHEDULE_TARGET, 1.0));
+
+    return std::min(std::max(bits, MIN_RANGE_BITS), MAX_RANGE_BITS);
+}
+
+// Each device has its own context, in-order queue and a single counter, hit
+// count and hit list; ranges run one at a time, SCHEDULE_TARGET being long
+// enough to hide the launch and read back.
+struct DeviceWorker
+{
+    Device device;
+    cl_context context = NULL;
+    cl_command_queue queue = NULL;
+    cl_program program = NULL;
+    cl_kernel kernel = NULL;
+    cl_mem result = NULL;
+    cl_mem hitCount = NULL;
+    cl_mem hits = NULL;
+    std::size_t localSize = 0;
+    cl_uint block = 1;
+    bool blocked = false;
+};
+
+bool setupDeviceWorker(DeviceWorker &worker, const ScheduleOptions &options)
+{
+    cl_int err = CL_SUCCESS;
 
-cl_ulong hist[256];
+    worker.context = clCreateContext(0, 1, &worker.device.id, NULL, NULL, &err);
 
-std::size_t localSize = 32;
+    if (!worker.context)
+        return false;
+
+    worker.queue = clCreateCommandQueue(worker.context, worker.device.id, 0, &err);
+    worker.program = worker.queue ? buildProgram(worker.context, worker.device, options.source, options.buildOptions, options.cacheDir) : NULL;
+    worker.kernel = worker.program ? clCreateKernel(worker.program, "compute", &err) : NULL;
+
+    if (!worker.kernel)
+        return false;
+
+    cl_uint kernelArgs = 0;
+    clGetKernelInfo(worker.kernel, CL_KERNEL_NUM_ARGS, sizeof(kernelArgs), &kernelArgs, NULL);
+    worker.blocked = kernelArgs == 9;
+    worker.block = worker.blocked ? block : 1;
+
+    clGetKernelWorkGroupInfo(worker.kernel, worker.device.id, CL_KERNEL_WORK_GROUP_SIZE, sizeof(worker.localSize), &worker.localSize, NULL);
 
-int result;
-cl_mem d_result;
-cl_mem d_offset;
-bignum offset;
+    TuneConfig profile;
 
-int dualCount;
-cl_mem d_dualCount;
+    if (!options.profileDir.empty() &&
+        loadProfile(getProfilePath(options.profileDir, worker.device.platform, worker.device.id), options.kernelPath + " " + options.buildOptions, profile))
+    {
+        worker.localSize = std::min(worker.localSize, profile.local);
+
+        if (worker.blocked && !options.blockGiven)
+            worker.block = profile.block;
+    }
+
+    if (options.localGiven)
+        worker.localSize = options.localGiven;
+
+    worker.result = clCreateBuffer(worker.context, CL_MEM_READ_WRITE, sizeof(cl_ulong), NULL, NULL);
+    worker.hitCount = clCreateBuffer(worker.context, CL_MEM_READ_WRITE, sizeof(cl_ulong), NULL, NULL);
+    worker.hits = clCreateBuffer(worker.context, CL_MEM_READ_WRITE, sizeof(cl_ulong) * std::max(hitCapacity, 1u), NULL, NULL);
+
+    return worker.result && worker.hitCount && worker.hits && worker.localSize > 0;
+}
+
+void releaseDeviceWorker(DeviceWorker &worker)
+{
+    if (worker.hits)
+        clReleaseMemObject(worker.hits);
+    if (worker.hitCount)
+        clReleaseMemObject(worker.hitCount);
+    if (worker.result)
+        clReleaseMemObject(worker.result);
+    if (worker.kernel)
+        clReleaseKernel(worker.kernel);
+    if (worker.program)
+        clReleaseProgram(worker.program);
+    if (worker.queue)
+        clReleaseCommandQueue(worker.queue);
+    if (worker.context)
+        clReleaseContext(worker.context);
+}
 
-bignum runChunk(bignum offset, bignum chunkSize, bignum total)
+// Counts [first, first + count) on the device and appends its hits. A range
+// with more hits than the list holds is split in halves and run again; a
+// single function has at most one hit, so that only fails on a broken device.
+cl_int runDeviceRange(DeviceWorker &worker, bignum first, bignum count, cl_ulong &found, std::vector<cl_ulong> &hits)
 {
-    auto offsetResult = clEnqueueWriteBuffer(queue, d_offset, CL_TRUE, 0, sizeof(bignum), &offset, 0, NULL, NULL);
+    cl_ulong zero = 0;
+    cl_ulong offsetArg = first;
+    cl_ulong countArg = count;
+    cl_uint capacityArg = hitCapacity;
+    cl_uint slotArg = 0;
+
+    cl_int err = clEnqueueWriteBuffer(worker.queue, worker.result, CL_FALSE, 0, sizeof(cl_ulong), &zero, 0, NULL, NULL);
+    err |= clEnqueueWriteBuffer(worker.queue, worker.hitCount, CL_FALSE, 0, sizeof(cl_ulong), &zero, 0, NULL, NULL);
+
+    clSetKernelArg(worker.kernel, 0, sizeof(cl_mem), &worker.result);
+    clSetKernelArg(worker.kernel, 1, sizeof(cl_ulong), &offsetArg);
+    clSetKernelArg(worker.kernel, 2, sizeof(cl_ulong), &countArg);
+    clSetKernelArg(worker.kernel, 3, sizeof(cl_mem), &worker.hitCount);
+    clSetKernelArg(worker.kernel, 4, sizeof(cl_mem), &worker.hits);
+    clSetKernelArg(worker.kernel, 5, sizeof(cl_uint), &capacityArg);
+    clSetKernelArg(worker.kernel, 6, sizeof(cl_uint), &slotArg);
 
-    if (offsetResult)
+    std::size_t items = (count + worker.block - 1) / worker.block;
+    std::size_t local = std::min(worker.localSize, items);
+    std::size_t globalSize = (items + local - 1) / local * local;
+
+    if (worker.blocked)
     {
-        printf("Error writing offset result %d\n", offsetResult);
-        return 1;
+        clSetKernelArg(worker.kernel, 7, sizeof(cl_uint), &worker.block);
+        clSetKernelArg(worker.kernel, 8, sizeof(cl_ulong) * local, NULL);
     }
 
-    auto outQueueResult = clEnqueueWriteBuffer(queue, d_result, CL_TRUE, 0, sizeof(int), &result, 0, NULL, NULL);
+    cl_ulong rangeResult = 0;
+    cl_ulong rangeHits = 0;
+
+    err |= clEnqueueNDRangeKernel(worker.queue, worker.kernel, 1, NULL, &globalSize, &local, 0, NULL, NULL);
+    err |= clEnqueueReadBuffer(worker.queue, worker.result, CL_FALSE, 0, sizeof(cl_ulong), &rangeResult, 0, NULL, NULL);
+    err |= clEnqueueReadBuffer(worker.queue, worker.hitCount, CL_TRUE, 0, sizeof(cl_ulong), &rangeHits, 0, NULL, NULL);
+
+    if (err)
+        return err;
 
-    if (outQueueResult)
+    if (rangeHits > hitCapacity)
     {
-        printf("Error writing to result buffer\n");
-        return 1;
+        if (count == 1)
+            return CL_OUT_OF_RESOURCES;
+
+        bignum half = count / 2;
+
+        err = runDeviceRange(worker, first, half, found, hits);
+
+        return err ? err : runDeviceRange(worker, first + half, count - half, found, hits);
     }
 
-    auto out2QueueResult = clEnqueueWriteBuffer(queue, d_dualCount, CL_TRUE, 0, sizeof(int), &dualCount, 0, NULL, NULL);
+    std::size_t stored = hits.size();
+    hits.resize(stored + rangeHits);
+
+    if (rangeHits)
+        err = clEnqueueReadBuffer(worker.queue, worker.hits, CL_TRUE, 0, sizeof(cl_ulong) * rangeHits, hits.data() + stored, 0, NULL, NULL);
+
+    found += rangeResult;
+
+    return err;
+}
+
+void runDeviceWorker(DeviceWorker &worker, int index, WorkQueue &work, WorkerStats &stats)
+{
+    int bits = MIN_RANGE_BITS + 6;
+    widenum_t first, end;
 
-    if (out2QueueResult)
+    while (work.take(bits, first, end))
     {
-        printf("Error writing to result2 buffer\n");
-        return 1;
+        auto start = std::chrono::steady_clock::now();
+        cl_ulong found = 0;
+
+        stats.error = runDeviceRange(worker, (bignum)first, (bignum)(end - first), found, stats.hits);
+
+        if (stats.error)
+            return;
+
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+        work.finish({first, end, found, index});
+        stats.functions += end - first;
+        stats.ranges++;
+        stats.seconds += seconds.count();
+        bits = getRangeBits((double)(end - first) / std::max(seconds.count(), 1e-6));
     }
+}
 
-    auto outQueueHist = clEnqueueWriteBuffer(queue, d_hist, CL_TRUE, 0, sizeof(cl_ulong) * 256, &hist, 0, NULL, NULL);
+// CPU threads run the Executor's pruned enumeration on their ranges
+void runCpuWorker(const ScheduleOptions &options, int index, WorkQueue &work, WorkerStats &stats)
+{
+    Executor executor(false);
+    std::vector<int> alpha(options.n, 1);
+
+    for (std::size_t i = 0; i < options.alpha.size(); i++)
+        alpha[i] = options.alpha[i] == '1';
+
+    executor.changeVectorSpaceSize(options.n, alpha.data());
+
+    int bits = MIN_RANGE_BITS + 6;
+    widenum_t first, end;
 
-    if (outQueueHist)
+    while (work.take(bits, first, end))
     {
-        printf("Error writing to hist buffer: %d\n", outQueueHist);
-        return 1;
+        auto start = std::chrono::steady_clock::now();
+        cl_ulong found = 0;
+
+        executor.enumerateMonotone(first, end - 1, [&](widenum_t f) {
+            if (options.selfDual && !isSelfDual((bignum)f, options.n))
+                return;
+
+            stats.hits.push_back((cl_ulong)f);
+            found++;
+        });
+
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+        work.finish({first, end, found, index});
+        stats.functions += end - first;
+        stats.ranges++;
+        stats.seconds += seconds.count();
+        bits = getRangeBits((double)(end - first) / std::max(seconds.count(), 1e-6));
     }
+}
+
+// --alpha digits for the results file, all ones without the option
+std::vector<int> getAlphaDigits(const std::string &alpha, int n)
+{
+    std::vector<int> digits(n, 1);
 
-    clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_N);
-    // clSetKernelArg(kernel, 1, sizeof(cl_mem), &d_hist);
-    clSetKernelArg(kernel, 1, sizeof(cl_mem), &d_result);
-    clSetKernelArg(kernel, 2, sizeof(cl_mem), &d_offset);
-    clSetKernelArg(kernel, 3, sizeof(cl_mem), &d_dualCount);
-    clSetKernelArg(kernel, 4, sizeof(cl_mem), &d_hist);
+    for (std::size_t i = 0; i < alpha.size(); i++)
+        digits[i] = alpha[i] == '1';
 
-    std::size_t globalSize = chunkSize;
-    std::size_t chunkLocalSize = chunkSize;
+    return digits;
+}
+
+int runSchedule(const std::vector<Device> &devices, const ScheduleOptions &options)
+{
+    std::vector<DeviceWorker> deviceWorkers(devices.size());
 
-    // printf("Queueing kernel with local size %lu and global size %lu\n", chunkLocalSize, globalSize);
+    for (std::size_t i = 0; i < devices.size(); i++)
+    {
+        deviceWorkers[i].device = devices[i];
 
-    auto kernelQueueResult = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &globalSize, &localSize, 0, NULL, NULL);
+        printf("Device %zu: [%s] %s (%s)\n", i, getDeviceTypeName(devices[i].type), devices[i].name.c_str(), devices[i].platformName.c_str());
 
-    // printf("Kernel queue result: %d\n", kernelQueueResult);
+        if (!setupDeviceWorker(deviceWorkers[i], options))
+        {
+            printf("Error preparing device %zu\n", i);
+            return 1;
+        }
+    }
 
-    if (kernelQueueResult)
+    if (deviceWorkers.empty() && options.cpuThreads == 0)
     {
-        char buildLog[2048];
-        clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, globalSize, buildLog, NULL);
-        printf("Error queuing kernel: %d \n", kernelQueueResult);
+        printf("No OpenCL device and no CPU threads to schedule on\n");
         return 1;
     }
 
-    // printf("Waiting for queue to finish... \n");
+    printf("CPU threads: %d\n", options.cpuThreads);
 
-    clFinish(queue);
+    WorkQueue work;
+    work.total = (widenum_t)1 << (1 << options.n);
+    work.n = options.n;
+    work.decreasing = options.decreasing;
+
+    std::cout << "funcs count: " << toString(work.total) << std::endl;
+
+    std::size_t workerCount = deviceWorkers.size() + options.cpuThreads;
+    std::vector<WorkerStats> stats(workerCount);
+    std::vector<std::thread> threads;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (std::size_t i = 0; i < deviceWorkers.size(); i++)
+    {
+        stats[i].name = std::string("[") + getDeviceTypeName(devices[i].type) + "] " + devices[i].name;
+        threads.emplace_back(runDeviceWorker, std::ref(deviceWorkers[i]), (int)i, std::ref(work), std::ref(stats[i]));
+    }
+
+    for (std::size_t i = deviceWorkers.size(); i < workerCount; i++)
+    {
+        stats[i].name = "[CPU thread] " + std::to_string(i - deviceWorkers.size());
+        threads.emplace_back(runCpuWorker, std::cref(options), (int)i, std::ref(work), std::ref(stats[i]));
+    }
+
+    for (auto &thread : threads)
+        thread.join();
+
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+    for (auto &worker : deviceWorkers)
+        releaseDeviceWorker(worker);
+
+    // ranges finish out of order, the log and the coverage check go by offset
+    std::sort(work.results.begin(), work.results.end(), [](const RangeResult &a, const RangeResult &b) { return a.first < b.first; });
+
+    for (auto &range : work.results)
+    {
+        double percent = ((double)range.end / (double)work.total) * 100;
+
+        std::cout << "Chunk (" << toString(range.first) << " , " << toString(range.end) << ", " << percent << "%) => " << range.count << std::endl;
+
+        if (range.first != covered)
+            gapFound = true;
+
+        covered = range.end;
+        result += range.count;
+
+        if (range.worker < 0)
+        {
+            prunedFunctions += range.end - range.first;
+            prunedChunks++;
+        }
+    }
+
+    std::vector<cl_ulong> merged;
+    bool failed = false;
+
+    for (auto &worker : stats)
+    {
+        double rate = worker.seconds > 0 ? (double)worker.functions / worker.seconds : 0;
+
+        std::cout << "Worker " << worker.name << ": " << toString(worker.functions) << " functions in " << worker.ranges << " ranges, " << rate
+                  << " functions/s" << std::endl;
+
+        if (worker.error)
+        {
+            printf("Worker %s failed: %d\n", worker.name.c_str(), worker.error);
+            failed = true;
+        }
+
+        merged.insert(merged.end(), worker.hits.begin(), worker.hits.end());
+    }
+
+    std::sort(merged.begin(), merged.end());
+
+    bignum dualCount = 0;
+
+    for (auto f : merged)
+        dualCount += isSelfDual(f, options.n);
 
-    // printf("Reading result... \n");
+    std::cout << "Result: " << result << " (" << toString(covered) << " / " << toString(work.total) << ")" << std::endl;
+    std::cout << "Self-dual: " << dualCount << std::endl;
 
-    clEnqueueReadBuffer(queue, d_result, CL_TRUE, 0, sizeof(int), &result, 0, NULL, NULL);
-    clEnqueueReadBuffer(queue, d_dualCount, CL_TRUE, 0, sizeof(int), &dualCount, 0, NULL, NULL);
-    clEnqueueReadBuffer(queue, d_hist, CL_TRUE, 0, sizeof(cl_ulong) * 256, &hist, 0, NULL, NULL);
+    if (prunedChunks)
+        std::cout << "Pruned on the host: " << toString(prunedFunctions) << " functions in " << prunedChunks << " ranges" << std::endl;
 
-    double percent = ((double)(offset + chunkSize) / (double)total) * 100;
+    printf("Time: %.3f s\n", seconds.count());
 
-    std::cout << "Chunk (" << offset << " , " << offset + chunkSize << ", " << percent << "%) => " << result << std::endl;
+    bool complete = covered == work.total && !gapFound && !failed && merged.size() == result;
 
-    return result;
+    if (!complete)
+        std::cout << "Incomplete sweep: the chunks do not cover every function" << std::endl;
+
+    if (!options.hitsPath.empty())
+    {
+        FILE *file = fopen(options.hitsPath.c_str(), "wb");
+
+        if (!file || fwrite(merged.data(), sizeof(cl_ulong), merged.size(), file) != merged.size())
+        {
+            printf("Error writing %s\n", options.hitsPath.c_str());
+            complete = false;
+        }
+
+        if (file)
+            fclose(file);
+
+        std::cout << "Hits written to " << options.hitsPath << ": " << merged.size() << std::endl;
+    }
+
+    if (!options.resultsPath.empty())
+    {
+        bool written = results.open(options.resultsPath, options.n, getAlphaDigits(options.alpha, options.n));
+
+        for (auto f : merged)
+            written = written && results.addFunction(f);
+
+        for (auto &range : work.results)
+            written = written && results.addChunk(range.first, range.end, range.count);
+
+        if (written)
+        {
+            results.setMetadata("program", "cltest --schedule");
+            results.setMetadata("self_dual", options.selfDual ? "1" : "0");
+            results.setMetadata("result", std::to_string(result));
+            results.setMetadata("complete", complete ? "1" : "0");
+            results.setMetadata("time_s", std::to_string(seconds.count()));
+            written = results.close();
+        }
+
+        if (!written)
+        {
+            printf("Error writing %s\n", options.resultsPath.c_str());
+            complete = false;
+        }
+        else
+            std::cout << "Results written to " << options.resultsPath << ": " << merged.size() << " functions, " << work.results.size() << " chunks" << std::endl;
+    }
+
+    return complete ? 0 : 1;
+}
+
+void printUsage()
+{
+    printf("usage: cltest N [--device cpu|gpu|all] [--index i] [--kernel path] [--block b]\n"
+           "              [--alpha a1..aN] [--self-dual] [--hits path] [--results path] [--hit-capacity c]\n"
+           "              [--local l] [--chunk c] [--autotune] [--profiles dir] [--no-profile]\n"
+           "              [--timing] [--timing-log path] [--no-prune] [--schedule] [--cpu-threads t]\n"
+           "              [--cache dir] [--no-cache] [--list]\n");
 }
 
 int main(int argc, char *argv[])
 {
-#ifdef __APPLE__
-    std::ifstream kernelFile("src/kernel_m.cl");
-#else
-    std::ifstream kernelFile("kernel.cl");
-#endif
+    int N = -1;
+    cl_device_type deviceType = CL_DEVICE_TYPE_ALL;
+    int deviceIndex = 0;
+    bool listOnly = false;
+    std::string kernelPath;
+    std::string hitsPath;
+    std::string resultsPath;
+    std::string alpha;
+    bool selfDual = false;
+    std::string cacheDir = ".cltest-cache";
+    std::string profileDir = ".cltest-profiles";
+    std::string timingPath;
+    bool schedule = false;
+    int cpuThreads = std::thread::hardware_concurrency();
+    bool autotuneOnly = false;
+    bool blockGiven = false;
+    std::size_t localGiven = 0;
+    bignum chunkGiven = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--device" && i + 1 < argc)
+        {
+            std::string type = argv[++i];
+
+            if (type == "cpu")
+                deviceType = CL_DEVICE_TYPE_CPU;
+            else if (type == "gpu")
+                deviceType = CL_DEVICE_TYPE_GPU;
+            else if (type == "all")
+                deviceType = CL_DEVICE_TYPE_ALL;
+            else
+            {
+                printUsage();
+                return 1;
+            }
+        }
+        else if (arg == "--index" && i + 1 < argc)
+            deviceIndex = std::atoi(argv[++i]);
+        else if (arg == "--kernel" && i + 1 < argc)
+            kernelPath = argv[++i];
+        else if (arg == "--block" && i + 1 < argc)
+        {
+            block = std::atoi(argv[++i]);
+            blockGiven = true;
+        }
+        else if (arg == "--local" && i + 1 < argc)
+            localGiven = std::strtoull(argv[++i], NULL, 10);
+        else if (arg == "--chunk" && i + 1 < argc)
+            chunkGiven = std::strtoull(argv[++i], NULL, 10);
+        else if (arg == "--autotune")
+            autotuneOnly = true;
+        else if (arg == "--profiles" && i + 1 < argc)
+            profileDir = argv[++i];
+        else if (arg == "--no-profile")
+            profileDir.clear();
+        else if (arg == "--timing")
+            timing = true;
+        else if (arg == "--no-prune")
+            pruning = false;
+        else if (arg == "--schedule")
+            schedule = true;
+        else if (arg == "--cpu-threads" && i + 1 < argc)
+            cpuThreads = std::atoi(argv[++i]);
+        else if (arg == "--timing-log" && i + 1 < argc)
+        {
+            timingPath = argv[++i];
+            timing = true;
+        }
+        else if (arg == "--hits" && i + 1 < argc)
+            hitsPath = argv[++i];
+        else if (arg == "--results" && i + 1 < argc)
+            resultsPath = argv[++i];
+        else if (arg == "--hit-capacity" && i + 1 < argc)
+            hitCapacity = std::strtoul(argv[++i], NULL, 10);
+        else if (arg == "--alpha" && i + 1 < argc)
+            alpha = argv[++i];
+        else if (arg == "--self-dual")
+            selfDual = true;
+        else if (arg == "--cache" && i + 1 < argc)
+            cacheDir = argv[++i];
+        else if (arg == "--no-cache")
+            cacheDir.clear();
+        else if (arg == "--list")
+            listOnly = true;
+        else if (arg[0] != '-' && N < 0)
+            N = std::atoi(arg.c_str());
+        else
+        {
+            printUsage();
+            return 1;
+        }
+    }
+
+    std::vector<Device> devices = getDevices(deviceType);
+
+    if (listOnly)
+    {
+        for (std::size_t i = 0; i < devices.size(); i++)
+        {
+            printf("%zu: [%s] %s (%s)\n", i, getDeviceTypeName(devices[i].type), devices[i].name.c_str(), devices[i].platformName.c_str());
+        }
+
+        return 0;
+    }
+
+    if (N < 0 || N > 6)
+    {
+        printUsage();
+        return 1;
+    }
+
+    // alpha_i = 0 asks for f decreasing in x_i, which is input bit N - 1 - i
+    int decreasing = 0;
+
+    if (!alpha.empty() && (int)alpha.size() != N)
+    {
+        printf("Alpha needs one digit per variable\n");
+        return 1;
+    }
+
+    for (std::size_t i = 0; i < alpha.size(); i++)
+    {
+        if (alpha[i] != '0' && alpha[i] != '1')
+        {
+            printf("Alpha digits are 0 or 1\n");
+            return 1;
+        }
+
+        if (alpha[i] == '0')
+            decreasing |= 1 << (N - 1 - i);
+    }
+
+    if (block == 0 || (block & (block - 1)))
+    {
+        printf("Block size must be a power of two\n");
+        return 1;
+    }
+
+    // --schedule keeps every hit to count the self-dual ones and check the total
+    if (schedule && hitCapacity == 0)
+    {
+        printf("--schedule needs a hit capacity of at least 1\n");
+        return 1;
+    }
+
+    // run from the repository root by default; the runpod setup copies the
+    // kernel next to the binary as kernel.cl, blocked runs use kernel_p.cl
+    if (kernelPath.empty())
+        kernelPath = block > 1 ? "src/kernel_p.cl" : "src/kernel_m.cl";
+
+    std::ifstream kernelFile(kernelPath);
+
+    if (!kernelFile && kernelPath == "src/kernel_m.cl")
+        kernelFile.open("kernel.cl");
+    else if (!kernelFile && kernelPath == "src/kernel_p.cl")
+        kernelFile.open("kernel_p.cl");
+
+    if (!kernelFile)
+    {
+        printf("Error opening kernel source %s\n", kernelPath.c_str());
+        return 1;
+    }
 
     std::string src(std::istreambuf_iterator<char>(kernelFile), (std::istreambuf_iterator<char>()));
 
-    const char *kernelSource = src.c_str();
+    // the kernels are specialized for N, the orientation and the mode
+    std::string buildOptions = "-D N=" + std::to_string(N) + " -D DECREASING=" + std::to_string(decreasing);
 
-    clGetPlatformIDs(1, &cpPlatform, NULL);
+    if (selfDual)
+        buildOptions += " -D SELF_DUAL";
 
-    int N = std::atoi(argv[1]);
+    if (schedule)
+    {
+        ScheduleOptions options;
+        options.n = N;
+        options.alpha = alpha;
+        options.decreasing = decreasing;
+        options.selfDual = selfDual;
+        options.cpuThreads = cpuThreads;
+        options.kernelPath = kernelPath;
+        options.source = src;
+        options.buildOptions = buildOptions;
+        options.cacheDir = cacheDir;
+        options.profileDir = profileDir;
+        options.hitsPath = hitsPath;
+        options.resultsPath = resultsPath;
+        options.blockGiven = blockGiven;
+        options.localGiven = localGiven;
 
-    cl_int err = 0;
+        return runSchedule(devices, options);
+    }
+
+    if (deviceIndex < 0 || deviceIndex >= (int)devices.size())
+    {
+        printf("No matching OpenCL device %d (found %zu), see --list\n", deviceIndex, devices.size());
+        return 1;
+    }
+
+    cpPlatform = devices[deviceIndex].platform;
+    device_id = devices[deviceIndex].id;
 
-    clGetDeviceIDs(cpPlatform, CL_DEVICE_TYPE_GPU, 1, &device_id, NULL);
+    printf("Device: [%s] %s (%s)\n", getDeviceTypeName(devices[deviceIndex].type), devices[deviceIndex].name.c_str(), devices[deviceIndex].platformName.c_str());
+
+    cl_int err = 0;
 
     context = clCreateContext(0, 1, &device_id, NULL, NULL, NULL);
 
-    queue = clCreateCommandQueue(context, device_id, 0, NULL);
+    // chunks only share the accumulators through atomics, so let the device
+    // overlap them when it can; events keep the bank reuse ordered
+    cl_command_queue_properties queueProperties = 0;
+    clGetDeviceInfo(device_id, CL_DEVICE_QUEUE_PROPERTIES, sizeof(queueProperties), &queueProperties, NULL);
 
-    program = clCreateProgramWithSource(context, 1, (const char **)&kernelSource, NULL, NULL);
+    queueProperties &= CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE;
 
-    auto buildError = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+    if (timing)
+        queueProperties |= CL_QUEUE_PROFILING_ENABLE;
 
-    if (buildError)
+    queue = clCreateCommandQueue(context, device_id, queueProperties, &err);
+
+    if (!queue)
     {
-        char buildLog[2048];
-        clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, 2048, buildLog, NULL);
-        printf("Error building program (%d): %s\n", buildError, buildLog);
+        printf("Error creating command queue: %d\n", err);
         return 1;
     }
 
+    program = buildProgram(context, devices[deviceIndex], src, buildOptions, cacheDir);
+
+    if (!program)
+        return 1;
+
     kernel = clCreateKernel(program, "compute", &err);
 
     if (!kernel)
@@ -150,85 +1462,298 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    d_N = clCreateBuffer(context, CL_MEM_READ_ONLY, sizeof(int), NULL, NULL);
-    d_result = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(int), NULL, NULL);
-    d_offset = clCreateBuffer(context, CL_MEM_READ_ONLY, sizeof(bignum), NULL, NULL);
-    d_dualCount = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(int), NULL, NULL);
-    d_hist = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(cl_ulong) * 256, NULL, NULL);
+    cl_uint kernelArgs = 0;
+    clGetKernelInfo(kernel, CL_KERNEL_NUM_ARGS, sizeof(kernelArgs), &kernelArgs, NULL);
+
+    // the blocked kernel also takes the block size and a local reduction buffer
+    blockedKernel = kernelArgs == 9;
+
+    if (block > 1 && !blockedKernel)
+    {
+        printf("Kernel %s does not take a block size\n", kernelPath.c_str());
+        return 1;
+    }
+
+    bool buffersCreated = true;
 
-    for (int i = 0; i < 256; i++)
+    for (int i = 0; i < 2; i++)
     {
-        hist[i] = 0;
+        d_result[i] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(chunkResult[i]), NULL, NULL);
+        d_hitCount[i] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(cl_ulong), NULL, NULL);
+        d_hits[i] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(cl_ulong) * std::max(hitCapacity, 1u), NULL, NULL);
+
+        buffersCreated = buffersCreated && d_result[i] && d_hitCount[i] && d_hits[i];
     }
 
-    if (!d_N || !d_result || !d_hist || !d_offset || !d_dualCount)
+    if (!buffersCreated)
     {
         printf("Error creating buffers\n");
         return 1;
     }
 
-    auto queueResult = clEnqueueWriteBuffer(queue, d_N, CL_TRUE, 0, sizeof(int), &N, 0, NULL, NULL);
+    // the accumulators are uploaded once and stay on the device until the end
+    cl_int queueResult = CL_SUCCESS;
+
+    for (int i = 0; i < 2; i++)
+    {
+        queueResult |= clEnqueueWriteBuffer(queue, d_result[i], CL_TRUE, 0, sizeof(chunkResult[i]), chunkResult[i], 0, NULL, NULL);
+        queueResult |= clEnqueueWriteBuffer(queue, d_hitCount[i], CL_TRUE, 0, sizeof(cl_ulong), &windows[i].hitCount, 0, NULL, NULL);
+    }
 
     if (queueResult)
     {
-        printf("Error writing to N buffer\n");
+        printf("Error initializing buffers\n");
         return 1;
     }
 
-    clGetKernelWorkGroupInfo(kernel, device_id, CL_KERNEL_WORK_GROUP_SIZE, sizeof(localSize), &localSize, NULL);
+    // only an upper bound, the profile or autotuning pick the actual size
+    std::size_t maxLocal = 0;
+    clGetKernelWorkGroupInfo(kernel, device_id, CL_KERNEL_WORK_GROUP_SIZE, sizeof(maxLocal), &maxLocal, NULL);
+    localSize = maxLocal;
 
-    // localSize = 256;
-    bignum functionsCount = N == 6 ? ULLONG_MAX - 1 : std::pow(2, std::pow(2, N));
-    // functionsCount = functionsCount >> 1; // divide by 2
-    std::cout << "funcs count: " << functionsCount << std::endl;
-    bignum chunkSize = N == 6 ? 67305472 : localSize;
+    // 2^64 for n = 6, only the 128-bit type holds the end of the space
+    widenum_t functionsCount = (widenum_t)1 << (1 << N);
+    std::cout << "funcs count: " << toString(functionsCount) << std::endl;
+    bignum chunkSize = N == 6 ? 1ULL << 26 : localSize;
     if (N == 5)
-        chunkSize = 16777216;
+        chunkSize = 1ULL << 24;
     if (N < 4)
         chunkSize = 8;
-    bignum chunkableCount = functionsCount - functionsCount % chunkSize;
 
-    bignum processed = 0;
-    int chunks = 0;
+    TuneConfig config;
+    config.local = localSize;
+    config.chunk = chunkSize;
+    config.block = block;
+
+    std::string profileKey = kernelPath + " " + buildOptions;
 
-    bignum percentStep = 0;
-    printf("local: %d\n", localSize);
-    while (processed < chunkableCount)
+    if (autotuneOnly)
     {
-        runChunk(processed, chunkSize, functionsCount);
+        config.local = std::min<std::size_t>(config.local, config.chunk / config.block);
+        config = autotune(config, functionsCount, maxLocal);
 
-        processed += chunkSize;
-        chunks++;
+        if (config.rate == 0)
+        {
+            printf("No configuration ran on this device\n");
+            return 1;
+        }
 
-        // float percent = ((double)processed / (double)functionsCount) * 100;
+        printf("Best: block %u, local %zu, chunk %llu: %.4g functions/s\n", config.block, config.local, config.chunk, config.rate);
 
-        // std::cout << "Chunk " << chunks << " => offset " << processed << "(" << percent << "%)" << std::endl;
+        if (!profileDir.empty())
+            saveProfile(profileDir, profileKey, config);
+
+        return 0;
     }
 
-    // result++; // last function is always monotonic
+    TuneConfig profile;
+
+    if (!profileDir.empty() && loadProfile(getProfilePath(profileDir, cpPlatform, device_id), profileKey, profile))
+    {
+        printf("Profile: block %u, local %zu, chunk %llu\n", profile.block, profile.local, profile.chunk);
 
-    std::cout << "Result: " << result << " (" << processed << " / " << functionsCount << ")" << std::endl;
-    std::cout << "Dual count out of " << result << ": " << dualCount << std::endl;
+        config.local = profile.local;
+        config.chunk = profile.chunk;
 
-    clReleaseMemObject(d_N);
-    clReleaseMemObject(d_result);
-    clReleaseMemObject(d_hist);
-    clReleaseMemObject(d_offset);
-    clReleaseMemObject(d_dualCount);
-    clReleaseProgram(program);
-    clReleaseKernel(kernel);
-    clReleaseCommandQueue(queue);
-    clReleaseContext(context);
+        if (blockedKernel && !blockGiven)
+            config.block = profile.block;
+    }
+
+    if (localGiven)
+        config.local = localGiven;
+    if (chunkGiven)
+        config.chunk = chunkGiven;
+
+    localSize = config.local;
+    chunkSize = config.chunk;
+    block = config.block;
 
-    std::ofstream histFile("hist.csv");
+    if (chunkSize == 0 || chunkSize % block)
+    {
+        printf("Block size %u does not divide the chunk size %llu\n", block, chunkSize);
+        return 1;
+    }
+
+    // CPU runtimes report work-group limits far above the small chunks
+    if (localSize > chunkSize / block)
+        localSize = chunkSize / block;
+
+    if (!hitsPath.empty())
+    {
+        hitsFile = fopen(hitsPath.c_str(), "wb");
+
+        if (!hitsFile)
+        {
+            printf("Error opening %s\n", hitsPath.c_str());
+            return 1;
+        }
+
+        hits.resize(hitCapacity);
+    }
+
+    if (!resultsPath.empty())
+    {
+        if (!results.open(resultsPath, N, getAlphaDigits(alpha, N)))
+        {
+            printf("Error opening %s\n", resultsPath.c_str());
+            return 1;
+        }
+
+        hits.resize(hitCapacity);
+    }
+
+
+    if (!timingPath.empty())
+    {
+        timingLog.open(timingPath);
+
+        if (!timingLog)
+        {
+            printf("Error opening %s\n", timingPath.c_str());
+            return 1;
+        }
+
+        timingLog << "kind,offset,count,queued_ns,submit_ns,start_ns,end_ns,duration_ns,gap_ns,per_second\n";
+    }
+
+    widenum_t processed = 0;
+    int bank = 0;
+
+    printf("local: %zu\n", localSize);
+    while (processed < functionsCount)
+    {
+        Window &window = windows[bank];
+
+        // the bank still holds the window before last, drain it first
+        if (finishWindow(bank, functionsCount))
+        {
+            printf("Error reading chunk results\n");
+            return 1;
+        }
+
+        window.first = processed;
+
+        // the kernels of this window, pruned chunks have none
+        std::vector<cl_event> events;
+
+        while (window.chunks < CHUNK_SLOTS && processed < functionsCount)
+        {
+            // the tail chunk covers whatever chunkSize does not divide
+            bignum count = std::min<widenum_t>(chunkSize, functionsCount - processed);
+            widenum_t pruned = pruning ? getPrunedCount(processed, count, functionsCount, N, decreasing) : 0;
+
+            if (pruned)
+            {
+                processed += pruned;
+                prunedFunctions += pruned;
+                prunedChunks++;
+                window.ends.push_back(processed);
+                window.kernels.push_back(NULL);
+                window.chunks++;
+                continue;
+            }
+
+            if (events.size() >= CHUNKS_IN_FLIGHT)
+                clWaitForEvents(1, &events[events.size() - CHUNKS_IN_FLIGHT]);
+
+            cl_event event;
+            auto kernelQueueResult = enqueueChunk((bignum)processed, count, bank, window.chunks, &event);
+
+            if (kernelQueueResult)
+            {
+                printf("Error queuing kernel: %d \n", kernelQueueResult);
+                return 1;
+            }
+
+            clFlush(queue);
+
+            events.push_back(event);
+            processed += count;
+            window.ends.push_back(processed);
+            window.kernels.push_back(event);
+            window.chunks++;
+        }
 
-    histFile << "INDEX,COUNT\n";
-    for (int i = 0; i < 256; i++)
+        // a window pruned whole only has to wait for its zeroing
+        if (events.empty() && window.reset)
+            events.push_back(window.reset);
+
+        auto readResult = clEnqueueReadBuffer(queue, d_result[bank], CL_FALSE, 0, sizeof(cl_ulong) * window.chunks, chunkResult[bank], events.size(),
+                                              events.empty() ? NULL : events.data(), &window.countsRead);
+
+        if (!readResult)
+            readResult = clEnqueueReadBuffer(queue, d_hitCount[bank], CL_FALSE, 0, sizeof(cl_ulong), &window.hitCount, 1, &window.countsRead, &window.read);
+
+        if (readResult)
+        {
+            printf("Error reading chunk results: %d\n", readResult);
+            return 1;
+        }
+
+        clFlush(queue);
+
+        bank ^= 1;
+    }
+
+    // older window first to keep the chunk log in order
+    if (finishWindow(bank, functionsCount) || finishWindow(bank ^ 1, functionsCount))
+    {
+        printf("Error reading chunk results\n");
+        return 1;
+    }
+
+    clFinish(queue);
+
+    std::cout << "Result: " << result << " (" << toString(covered) << " / " << toString(functionsCount) << ")" << std::endl;
+
+    bool complete = covered == functionsCount && !gapFound;
+
+    if (prunedChunks)
+        std::cout << "Pruned on the host: " << toString(prunedFunctions) << " functions in " << prunedChunks << " ranges" << std::endl;
+
+    if (timing)
+        printf("Timing: kernels %.3f s, transfers %.3f s, device idle between kernels %.3f s\n", kernelTime / 1e9, transferTime / 1e9, gapTime / 1e9);
+
+    if (!complete)
+        std::cout << "Incomplete sweep: the chunks do not cover every function" << std::endl;
+
+    if (hitsFile)
+    {
+        fclose(hitsFile);
+        std::cout << "Hits written to " << hitsPath << ": " << totalHits << (hitsOverflow ? " (incomplete)" : "") << std::endl;
+    }
+
+    if (results.isOpen())
+    {
+        results.setMetadata("program", "cltest");
+        results.setMetadata("device", devices[deviceIndex].name);
+        results.setMetadata("self_dual", selfDual ? "1" : "0");
+        results.setMetadata("result", std::to_string(result));
+        results.setMetadata("complete", complete && !hitsOverflow ? "1" : "0");
+
+        if (results.close())
+            std::cout << "Results written to " << resultsPath << ": " << totalHits << " functions" << (hitsOverflow ? " (incomplete)" : "") << std::endl;
+        else
+            printf("Error writing %s\n", resultsPath.c_str());
+    }
+
+    for (int i = 0; i < 2; i++)
     {
-        histFile << i + 1 << "," << hist[i] << "\n";
+        if (windows[i].resultReset)
+            clReleaseEvent(windows[i].resultReset);
+
+        if (windows[i].reset)
+            clReleaseEvent(windows[i].reset);
+
+        clReleaseMemObject(d_result[i]);
+        clReleaseMemObject(d_hitCount[i]);
+        clReleaseMemObject(d_hits[i]);
     }
 
-    histFile.close();
+    clReleaseProgram(program);
+    clReleaseKernel(kernel);
+    clReleaseCommandQueue(queue);
+    clReleaseContext(context);
 
-    return 0;
-}
\ No newline at end of file
+    return complete && !hitsOverflow ? 0 : 1;
+}
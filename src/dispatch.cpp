@@ -0,0 +1,411 @@
+#include <dispatch.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define QMF_X86 1
+#include <immintrin.h>
+#endif
+
+// The scalar bodies are always inlined, so each wrapper below compiles them
+// for its own target: the AVX2 tier gets POPCNT, BMI2 shifts and whatever
+// the compiler vectorizes from the same source.
+#define QMF_INLINE inline __attribute__((always_inline))
+
+// one number at a time most fail on the first variables, so stop there
+static QMF_INLINE bool isMonotoneWord(const PackedCheck &check, uint64_t f)
+{
+    for (int b = 0; b < check.bits; b++)
+    {
+        uint64_t shifted = f >> (1 << b);
+
+        if ((shifted & ~f & check.increasing[b]) | (f & ~shifted & check.decreasing[b]))
+            return false;
+    }
+
+    return true;
+}
+
+// numbers begin..count - 1, begin may be inside a word the vector loop started
+template <bool range>
+static QMF_INLINE void checkScalar(const PackedCheck &check, const uint64_t *numbers, uint64_t first, std::size_t begin,
+                                   std::size_t count, uint64_t *bitmap)
+{
+    for (std::size_t w = begin / 64; w < (count + 63) / 64; w++)
+    {
+        std::size_t end = std::min<std::size_t>(count, w * 64 + 64);
+        uint64_t word = begin % 64 && w == begin / 64 ? bitmap[w] : 0;
+
+        for (std::size_t i = std::max(begin, w * 64); i < end; i++)
+        {
+            uint64_t f = (range ? first + i : numbers[i]) & check.functionMask;
+
+            word |= (uint64_t)isMonotoneWord(check, f) << (i % 64);
+        }
+
+        bitmap[w] = word;
+    }
+}
+
+static QMF_INLINE bool checkWordsScalar(const PackedCheck &check, const uint64_t *words, std::size_t begin, std::size_t count)
+{
+    for (std::size_t k = begin; k < count; k++)
+    {
+        if (!isMonotoneWord(check, words[k]))
+            return false;
+    }
+
+    return true;
+}
+
+static QMF_INLINE int longestTerm(const PackedCheck &check, uint64_t minimal)
+{
+    int degree = 0;
+
+    // position bit b differs from the bottom of the alpha order where the term has variable b
+    for (; minimal; minimal &= minimal - 1)
+        degree = std::max(degree, __builtin_popcountll(__builtin_ctzll(minimal) ^ check.increasingBits));
+
+    return degree;
+}
+
+static QMF_INLINE uint64_t minimalPoints(const PackedCheck &check, uint64_t f)
+{
+    uint64_t minimal = f;
+
+    // a true point is minimal when its predecessor along every variable is false
+    for (int b = 0; b < check.bits; b++)
+    {
+        int shift = 1 << b;
+
+        minimal &= ~(((f >> shift) & check.increasing[b]) | ((f & check.decreasing[b]) << shift));
+    }
+
+    return minimal;
+}
+
+static QMF_INLINE void describeScalar(const PackedCheck &check, const uint64_t *functions, std::size_t begin, std::size_t count,
+                                      uint8_t *weights, uint8_t *minimalTerms, uint8_t *degrees)
+{
+    for (std::size_t i = begin; i < count; i++)
+    {
+        uint64_t minimal = minimalPoints(check, functions[i]);
+
+        weights[i] = __builtin_popcountll(functions[i]);
+        minimalTerms[i] = __builtin_popcountll(minimal);
+        degrees[i] = longestTerm(check, minimal);
+    }
+}
+
+// Generic
+
+static void checkBatchGeneric(const PackedCheck &check, const uint64_t *numbers, std::size_t count, uint64_t *bitmap)
+{
+    checkScalar<false>(check, numbers, 0, 0, count, bitmap);
+}
+
+static void checkRangeGeneric(const PackedCheck &check, uint64_t first, std::size_t count, uint64_t *bitmap)
+{
+    checkScalar<true>(check, nullptr, first, 0, count, bitmap);
+}
+
+static bool checkWordsGeneric(const PackedCheck &check, const uint64_t *words, std::size_t count)
+{
+    return checkWordsScalar(check, words, 0, count);
+}
+
+static void describeGeneric(const PackedCheck &check, const uint64_t *functions, std::size_t count, uint8_t *weights,
+                            uint8_t *minimalTerms, uint8_t *degrees)
+{
+    describeScalar(check, functions, 0, count, weights, minimalTerms, degrees);
+}
+
+static const Kernels GENERIC_KERNELS = {CpuLevel::Generic, checkBatchGeneric, checkRangeGeneric, checkWordsGeneric,
+                                        describeGeneric};
+
+#ifdef QMF_X86
+
+// AVX2: 4 numbers per register, a lane is monotone when no violation is left
+
+#define QMF_AVX2 __attribute__((target("avx2,bmi,bmi2,popcnt")))
+
+QMF_AVX2 static inline __m256i violationsAvx2(const PackedCheck &check, __m256i f)
+{
+    __m256i violations = _mm256_setzero_si256();
+
+    for (int b = 0; b < check.bits; b++)
+    {
+        __m256i shifted = _mm256_srl_epi64(f, _mm_cvtsi32_si128(1 << b));
+        __m256i up = _mm256_and_si256(_mm256_andnot_si256(f, shifted), _mm256_set1_epi64x(check.increasing[b]));
+        __m256i down = _mm256_and_si256(_mm256_andnot_si256(shifted, f), _mm256_set1_epi64x(check.decreasing[b]));
+
+        violations = _mm256_or_si256(violations, _mm256_or_si256(up, down));
+
+        // as in the scalar test, stop once every lane has failed
+        if (!_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(violations, _mm256_setzero_si256()))))
+            break;
+    }
+
+    return violations;
+}
+
+template <bool range>
+QMF_AVX2 static void checkAvx2(const PackedCheck &check, const uint64_t *numbers, uint64_t first, std::size_t count,
+                               uint64_t *bitmap)
+{
+    const __m256i mask = _mm256_set1_epi64x(check.functionMask);
+    const __m256i lanes = _mm256_setr_epi64x(0, 1, 2, 3);
+    std::size_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256i f = range ? _mm256_add_epi64(_mm256_set1_epi64x(first + i), lanes)
+                          : _mm256_loadu_si256((const __m256i *)(numbers + i));
+        __m256i clean = _mm256_cmpeq_epi64(violationsAvx2(check, _mm256_and_si256(f, mask)), _mm256_setzero_si256());
+        uint64_t bits = _mm256_movemask_pd(_mm256_castsi256_pd(clean));
+
+        if (i % 64 == 0)
+            bitmap[i / 64] = 0;
+
+        bitmap[i / 64] |= bits << (i % 64);
+    }
+
+    checkScalar<range>(check, numbers, first, i, count, bitmap);
+}
+
+QMF_AVX2 static void checkBatchAvx2(const PackedCheck &check, const uint64_t *numbers, std::size_t count, uint64_t *bitmap)
+{
+    checkAvx2<false>(check, numbers, 0, count, bitmap);
+}
+
+QMF_AVX2 static void checkRangeAvx2(const PackedCheck &check, uint64_t first, std::size_t count, uint64_t *bitmap)
+{
+    checkAvx2<true>(check, nullptr, first, count, bitmap);
+}
+
+QMF_AVX2 static bool checkWordsAvx2(const PackedCheck &check, const uint64_t *words, std::size_t count)
+{
+    std::size_t k = 0;
+
+    for (; k + 4 <= count; k += 4)
+    {
+        __m256i violations = violationsAvx2(check, _mm256_loadu_si256((const __m256i *)(words + k)));
+
+        if (!_mm256_testz_si256(violations, violations))
+            return false;
+    }
+
+    return checkWordsScalar(check, words, k, count);
+}
+
+QMF_AVX2 static void describeAvx2(const PackedCheck &check, const uint64_t *functions, std::size_t count, uint8_t *weights,
+                                  uint8_t *minimalTerms, uint8_t *degrees)
+{
+    describeScalar(check, functions, 0, count, weights, minimalTerms, degrees);
+}
+
+static const Kernels AVX2_KERNELS = {CpuLevel::Avx2, checkBatchAvx2, checkRangeAvx2, checkWordsAvx2, describeAvx2};
+
+// AVX-512: 8 numbers per register, the lane mask is the bitmap byte itself
+
+#define QMF_AVX512 __attribute__((target("avx512f,avx2,bmi,bmi2,popcnt")))
+
+QMF_AVX512 static inline __m512i violationsAvx512(const PackedCheck &check, __m512i f)
+{
+    __m512i violations = _mm512_setzero_si512();
+
+    for (int b = 0; b < check.bits; b++)
+    {
+        __m512i shifted = _mm512_srl_epi64(f, _mm_cvtsi32_si128(1 << b));
+        __m512i up = _mm512_and_si512(_mm512_andnot_si512(f, shifted), _mm512_set1_epi64(check.increasing[b]));
+        __m512i down = _mm512_and_si512(_mm512_andnot_si512(shifted, f), _mm512_set1_epi64(check.decreasing[b]));
+
+        violations = _mm512_or_si512(violations, _mm512_or_si512(up, down));
+
+        if (_mm512_test_epi64_mask(violations, violations) == 0xFF)
+            break;
+    }
+
+    return violations;
+}
+
+template <bool range>
+QMF_AVX512 static void checkAvx512(const PackedCheck &check, const uint64_t *numbers, uint64_t first, std::size_t count,
+                                   uint64_t *bitmap)
+{
+    const __m512i mask = _mm512_set1_epi64(check.functionMask);
+    const __m512i lanes = _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+    std::size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m512i f = range ? _mm512_add_epi64(_mm512_set1_epi64(first + i), lanes) : _mm512_loadu_si512(numbers + i);
+        __m512i violations = violationsAvx512(check, _mm512_and_si512(f, mask));
+        uint64_t bits = (uint8_t)~_mm512_test_epi64_mask(violations, violations);
+
+        if (i % 64 == 0)
+            bitmap[i / 64] = 0;
+
+        bitmap[i / 64] |= bits << (i % 64);
+    }
+
+    checkScalar<range>(check, numbers, first, i, count, bitmap);
+}
+
+QMF_AVX512 static void checkBatchAvx512(const PackedCheck &check, const uint64_t *numbers, std::size_t count, uint64_t *bitmap)
+{
+    checkAvx512<false>(check, numbers, 0, count, bitmap);
+}
+
+QMF_AVX512 static void checkRangeAvx512(const PackedCheck &check, uint64_t first, std::size_t count, uint64_t *bitmap)
+{
+    checkAvx512<true>(check, nullptr, first, count, bitmap);
+}
+
+QMF_AVX512 static bool checkWordsAvx512(const PackedCheck &check, const uint64_t *words, std::size_t count)
+{
+    std::size_t k = 0;
+
+    for (; k + 8 <= count; k += 8)
+    {
+        __m512i violations = violationsAvx512(check, _mm512_loadu_si512(words + k));
+
+        if (_mm512_test_epi64_mask(violations, violations))
+            return false;
+    }
+
+    return checkWordsScalar(check, words, k, count);
+}
+
+// weights and minimal term counts of 8 functions from VPOPCNTDQ, only the
+// longest term walks the minimal points one by one
+__attribute__((target("avx512f,avx512vpopcntdq,avx2,bmi,bmi2,popcnt"))) static void describeAvx512(
+    const PackedCheck &check, const uint64_t *functions, std::size_t count, uint8_t *weights, uint8_t *minimalTerms,
+    uint8_t *degrees)
+{
+    std::size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m512i f = _mm512_loadu_si512(functions + i);
+        __m512i minimal = f;
+
+        for (int b = 0; b < check.bits; b++)
+        {
+            __m128i shift = _mm_cvtsi32_si128(1 << b);
+            __m512i up = _mm512_and_si512(_mm512_srl_epi64(f, shift), _mm512_set1_epi64(check.increasing[b]));
+            __m512i down = _mm512_sll_epi64(_mm512_and_si512(f, _mm512_set1_epi64(check.decreasing[b])), shift);
+
+            minimal = _mm512_andnot_si512(_mm512_or_si512(up, down), minimal);
+        }
+
+        uint64_t points[8];
+
+        _mm512_storeu_si512(points, minimal);
+        _mm_storel_epi64((__m128i *)(weights + i), _mm512_cvtepi64_epi8(_mm512_popcnt_epi64(f)));
+        _mm_storel_epi64((__m128i *)(minimalTerms + i), _mm512_cvtepi64_epi8(_mm512_popcnt_epi64(minimal)));
+
+        for (int lane = 0; lane < 8; lane++)
+            degrees[i + lane] = longestTerm(check, points[lane]);
+    }
+
+    describeScalar(check, functions, i, count, weights, minimalTerms, degrees);
+}
+
+static const Kernels AVX512_KERNELS = {CpuLevel::Avx512, checkBatchAvx512, checkRangeAvx512, checkWordsAvx512, describeAvx2};
+
+static const Kernels AVX512_POPCNT_KERNELS = {CpuLevel::Avx512, checkBatchAvx512, checkRangeAvx512, checkWordsAvx512,
+                                              describeAvx512};
+
+#endif
+
+static CpuFeatures detectCpuFeatures()
+{
+    CpuFeatures features;
+
+#ifdef QMF_X86
+    // also checks that the OS saves the AVX and AVX-512 registers
+    __builtin_cpu_init();
+
+    features.popcnt = __builtin_cpu_supports("popcnt");
+    features.bmi2 = __builtin_cpu_supports("bmi2");
+    features.avx2 = __builtin_cpu_supports("avx2");
+    features.avx512f = __builtin_cpu_supports("avx512f");
+    features.avx512vpopcntdq = __builtin_cpu_supports("avx512vpopcntdq");
+    features.avx512vbmi = __builtin_cpu_supports("avx512vbmi");
+#endif
+
+    return features;
+}
+
+const CpuFeatures &getCpuFeatures()
+{
+    static const CpuFeatures features = detectCpuFeatures();
+
+    return features;
+}
+
+static CpuLevel detectCpuLevel()
+{
+    const CpuFeatures &features = getCpuFeatures();
+    CpuLevel level = CpuLevel::Generic;
+
+    if (features.avx2 && features.bmi2 && features.popcnt)
+    {
+        level = CpuLevel::Avx2;
+
+        if (features.avx512f)
+            level = CpuLevel::Avx512;
+    }
+
+    const char *limit = std::getenv("QMF_CPU");
+
+    for (CpuLevel lower : {CpuLevel::Generic, CpuLevel::Avx2})
+    {
+        if (limit && std::strcmp(limit, toString(lower)) == 0 && lower < level)
+            level = lower;
+    }
+
+    return level;
+}
+
+CpuLevel getCpuLevel()
+{
+    static const CpuLevel level = detectCpuLevel();
+
+    return level;
+}
+
+const char *toString(CpuLevel level)
+{
+    switch (level)
+    {
+    case CpuLevel::Avx2:
+        return "avx2";
+    case CpuLevel::Avx512:
+        return "avx512";
+    default:
+        return "generic";
+    }
+}
+
+const Kernels &getKernels(CpuLevel level)
+{
+    level = std::min(level, getCpuLevel());
+
+#ifdef QMF_X86
+    switch (level)
+    {
+    case CpuLevel::Avx2:
+        return AVX2_KERNELS;
+    case CpuLevel::Avx512:
+        return getCpuFeatures().avx512vpopcntdq ? AVX512_POPCNT_KERNELS : AVX512_KERNELS;
+    default:
+        break;
+    }
+#endif
+
+    return GENERIC_KERNELS;
+}
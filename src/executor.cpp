@@ -1,9 +1,19 @@
 #include <Eigen/KroneckerProduct>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cofactors.hpp>
+#include <cstdio>
+#include <cstring>
 #include <executor.hpp>
 #include <iostream>
+#include <thread>
 
-typedef unsigned long long bignum_t;
+// cofactor interval counts kept per size, the map is dropped when it grows past this
+const std::size_t MAX_INTERVAL_COUNTS = 1 << 20;
+
+// monotone functions handed to Kernels::describe at once
+const std::size_t STATISTICS_BATCH = 1024;
 
 Eigen::MatrixXf logicalTrueConstantMatrix{
     {1, 0},
@@ -18,7 +28,7 @@ Eigen::MatrixXf getConstantMatrix(bool value)
     return value ? logicalTrueConstantMatrix : logicalFalseConstantMatrix;
 }
 
-Executor::Executor()
+Executor::Executor(bool verbose) : mVerbose(verbose), mKernels(&getKernels(::getCpuLevel()))
 {
     changeVectorSpaceSize(2);
 }
@@ -27,38 +37,252 @@ void Executor::changeVectorSpaceSize(int size, int *alpha)
 {
     mVectorSpaceSize = size;
 
-    m_alphaSet = new int[size];
-
+    // the caller owns alpha, keep a copy
     if (alpha == nullptr)
     {
-        for (int i = 0; i < size; i++)
+        m_alphaSet.assign(size, 1);
+    }
+    else
+    {
+        m_alphaSet.assign(alpha, alpha + size);
+    }
+
+    preparePackedEngine();
+    openStore();
+
+    if (!usePrecomputation())
+    {
+        mCache.emplace_front();
+        mTables = &mCache.front();
+        mTables->size = size;
+        mTables->alpha = m_alphaSet;
+
+        if (mCache.size() > mCacheCapacity)
+            mCache.pop_back();
+
+        if (!loadPrecomputation())
         {
-            m_alphaSet[i] = 1;
+            preparePermutations();
+            prepareMonotoneTable();
+            prepareTransitionMatrices();
+            savePrecomputation();
         }
     }
-    else
+
+    // the same output whether the operators were built, cached or read back
+    if (mVerbose)
+        printTransitionMatrices();
+}
+
+void Executor::setCacheDirectory(const std::string &directory)
+{
+    mCacheDirectory = directory;
+    mRanking.setDirectory(directory);
+}
+
+void Executor::setCacheCapacity(std::size_t capacity)
+{
+    // the current configuration always stays
+    mCacheCapacity = std::max<std::size_t>(capacity, 1);
+
+    while (mCache.size() > mCacheCapacity)
+        mCache.pop_back();
+}
+
+bool Executor::usePrecomputation()
+{
+    for (auto entry = mCache.begin(); entry != mCache.end(); ++entry)
+    {
+        if (entry->size != mVectorSpaceSize || entry->alpha != m_alphaSet)
+            continue;
+
+        mCache.splice(mCache.begin(), mCache, entry);
+        mTables = &mCache.front();
+        return true;
+    }
+
+    return false;
+}
+
+static const char TABLES_MAGIC[8] = {'Q', 'M', 'F', 'T', 'A', 'B', 'L', 'E'};
+static const uint32_t TABLES_VERSION = 1;
+
+// native byte order, like the stores and the ranking levels
+struct TablesHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t size;
+    uint64_t alpha; // bit i is alpha_i
+    uint64_t permutationCount;
+    uint64_t stepCount;
+    uint64_t tableWords;
+    uint64_t matrixSize;
+};
+
+static uint64_t packAlpha(const std::vector<int> &alpha)
+{
+    uint64_t bits = 0;
+
+    for (std::size_t i = 0; i < alpha.size(); i++)
+        bits |= (uint64_t)(alpha[i] != 0) << i;
+
+    return bits;
+}
+
+std::string Executor::getPrecomputationPath() const
+{
+    std::string path = mCacheDirectory + "/tables-" + std::to_string(mVectorSpaceSize) + "-";
+
+    for (int a : m_alphaSet)
+        path += a ? '1' : '0';
+
+    return path + ".qmc";
+}
+
+// reads what preparePermutations, prepareMonotoneTable and
+// prepareTransitionMatrices would build; the interval counts start empty
+bool Executor::loadPrecomputation()
+{
+    if (mCacheDirectory.empty() || mVectorSpaceSize > MAX_PACKED_SIZE)
+        return false;
+
+    FILE *file = fopen(getPrecomputationPath().c_str(), "rb");
+
+    if (!file)
+        return false;
+
+    int n = mVectorSpaceSize;
+    uint64_t permutationCount = 1;
+
+    for (int i = 2; i <= n; i++)
+        permutationCount *= i;
+
+    uint64_t tableWords = n <= MAX_TABLE_SIZE ? (1ULL << (1 << n)) / 64 + 2 : 0;
+    uint64_t matrixSize = n <= MAX_TRANSFORM_SIZE ? 1ULL << n : 0;
+
+    TablesHeader header;
+
+    bool read = fread(&header, sizeof(header), 1, file) == 1 && std::memcmp(header.magic, TABLES_MAGIC, sizeof(header.magic)) == 0 &&
+                header.version == TABLES_VERSION && header.size == (uint32_t)n && header.alpha == packAlpha(m_alphaSet) &&
+                header.permutationCount == permutationCount && header.stepCount == permutationCount - 1 &&
+                header.tableWords == tableWords && header.matrixSize == matrixSize;
+
+    if (read)
+    {
+        Precomputation &tables = *mTables;
+
+        tables.permutationCount = permutationCount;
+        tables.permutationSteps.resize(header.stepCount);
+        tables.monotoneTable.resize(tableWords);
+        tables.transitionMatrix.resize(matrixSize, matrixSize);
+        tables.transitionMatrixInverse.resize(matrixSize, matrixSize);
+
+        std::size_t entries = matrixSize * matrixSize;
+
+        read = fread(tables.swapMasks, sizeof(tables.swapMasks), 1, file) == 1 &&
+               fread(tables.permutationSteps.data(), 1, tables.permutationSteps.size(), file) == tables.permutationSteps.size() &&
+               fread(tables.monotoneTable.data(), sizeof(uint64_t), tableWords, file) == tableWords &&
+               fread(tables.transitionMatrix.data(), sizeof(float), entries, file) == entries &&
+               fread(tables.transitionMatrixInverse.data(), sizeof(float), entries, file) == entries && fgetc(file) == EOF;
+
+        for (uint8_t step : tables.permutationSteps)
+            read = read && step + 1 < n;
+
+        if (!read)
+        {
+            tables.permutationCount = 1;
+            tables.permutationSteps.clear();
+            tables.monotoneTable.clear();
+            tables.transitionMatrix.resize(0, 0);
+            tables.transitionMatrixInverse.resize(0, 0);
+        }
+    }
+
+    fclose(file);
+    return read;
+}
+
+bool Executor::savePrecomputation() const
+{
+    if (mCacheDirectory.empty() || mVectorSpaceSize > MAX_PACKED_SIZE)
+        return false;
+
+    const Precomputation &tables = *mTables;
+    TablesHeader header;
+
+    std::memcpy(header.magic, TABLES_MAGIC, sizeof(header.magic));
+    header.version = TABLES_VERSION;
+    header.size = mVectorSpaceSize;
+    header.alpha = packAlpha(m_alphaSet);
+    header.permutationCount = tables.permutationCount;
+    header.stepCount = tables.permutationSteps.size();
+    header.tableWords = tables.monotoneTable.size();
+    header.matrixSize = tables.transitionMatrix.rows();
+
+    std::size_t entries = tables.transitionMatrix.size();
+
+    // written aside and renamed, as the stores are
+    std::string path = getPrecomputationPath(), temporaryPath = path + ".tmp";
+    FILE *file = fopen(temporaryPath.c_str(), "wb");
+
+    if (!file)
+        return false;
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(tables.swapMasks, sizeof(tables.swapMasks), 1, file) == 1 &&
+                   fwrite(tables.permutationSteps.data(), 1, tables.permutationSteps.size(), file) == tables.permutationSteps.size() &&
+                   fwrite(tables.monotoneTable.data(), sizeof(uint64_t), tables.monotoneTable.size(), file) == tables.monotoneTable.size() &&
+                   fwrite(tables.transitionMatrix.data(), sizeof(float), entries, file) == entries &&
+                   fwrite(tables.transitionMatrixInverse.data(), sizeof(float), entries, file) == entries;
+
+    written = fclose(file) == 0 && written;
+
+    if (!written || std::rename(temporaryPath.c_str(), path.c_str()) != 0)
     {
-        m_alphaSet = alpha;
+        std::remove(temporaryPath.c_str());
+        return false;
     }
 
-    mTransitionMatrix = getConstantMatrix(m_alphaSet[0]);
+    return true;
+}
+
+void Executor::prepareTransitionMatrices()
+{
+    if (mVectorSpaceSize > MAX_TRANSFORM_SIZE)
+        return;
+
+    if (mVectorSpaceSize == 0)
+    {
+        // constant functions only, the transform is identity
+        mTables->transitionMatrix = Eigen::MatrixXf::Identity(1, 1);
+    }
+    else
+    {
+        mTables->transitionMatrix = getConstantMatrix(m_alphaSet[0]);
+    }
 
     for (int i = 1; i < mVectorSpaceSize; i++)
     {
-        auto constant = getConstantMatrix(m_alphaSet);
-        auto newMatrix = Eigen::kroneckerProduct(mTransitionMatrix, constant);
-        mTransitionMatrix = newMatrix.eval();
+        auto constant = getConstantMatrix(m_alphaSet[i]);
+        auto newMatrix = Eigen::kroneckerProduct(mTables->transitionMatrix, constant);
+        mTables->transitionMatrix = newMatrix.eval();
     }
 
-    mTransitionMatrixInverse = mTransitionMatrix.inverse().transpose();
+    mTables->transitionMatrixInverse = mTables->transitionMatrix.inverse().transpose();
+}
+
+void Executor::printTransitionMatrices() const
+{
+    if (mVectorSpaceSize > MAX_TRANSFORM_SIZE)
+        return;
 
     std::cout
         << "Kf:\n"
-        << mTransitionMatrix << std::endl;
+        << mTables->transitionMatrix << std::endl;
 
     std::cout
         << "Kf_inverse:\n"
-        << mTransitionMatrixInverse << std::endl;
+        << mTables->transitionMatrixInverse << std::endl;
 }
 
 void quickTransformer(std::vector<int8_t> &f, int subIndex, int n)
@@ -75,7 +299,7 @@ void quickTransformer(std::vector<int8_t> &f, int subIndex, int n)
         {
             if (subIndex == 0)
             {
-                f[i] = fo[2 * i] + fo[2 * i - npower + 1];
+                f[i] = fo[2 * i] + fo[2 * i + 1];
             }
             else
             {
@@ -158,6 +382,17 @@ std::vector<int8_t> Executor::useQuickTransformation(std::vector<uint8_t> f, boo
 }
 
 bool Executor::calculateMonotonicity(std::size_t functionNumber, bool debug)
+{
+    if (mVectorSpaceSize > MAX_TRANSFORM_SIZE)
+        return calculateMonotonicity(TruthTable::fromNumber(functionNumber, mVectorSpaceSize));
+
+    if (mStore.isOpen() && !debug)
+        return mStore.contains(functionNumber & mFunctionMask);
+
+    return calculateTransform(functionNumber, debug);
+}
+
+bool Executor::calculateTransform(std::size_t functionNumber, bool debug)
 {
     auto begin = std::chrono::high_resolution_clock::now();
 
@@ -185,8 +420,8 @@ bool Executor::calculateMonotonicity(std::size_t functionNumber, bool debug)
         fVector[i] = func[i];
     }
 
-    auto fKfVector = mTransitionMatrix * fVector;
-    auto fEnergySpectreVector = (mTransitionMatrix * fVector).cwiseProduct(mTransitionMatrixInverse * fVector);
+    auto fKfVector = mTables->transitionMatrix * fVector;
+    auto fEnergySpectreVector = (mTables->transitionMatrix * fVector).cwiseProduct(mTables->transitionMatrixInverse * fVector);
 
     auto qbegin = std::chrono::high_resolution_clock::now();
     auto fQuickTransformed = useQuickTransformation(func, false);
@@ -237,9 +472,17 @@ bool Executor::calculateMonotonicity(std::size_t functionNumber, bool debug)
         std::cout << "qtransform time => (" << qtime << "mcs )" << std::endl;
     }
 
+    // the energy collects at the top vector of the alpha order, x = alpha
+    std::size_t topIndex = 0;
+
+    for (int i = 0; i < mVectorSpaceSize; i++)
+    {
+        topIndex = (topIndex << 1) | (m_alphaSet[i] != 0);
+    }
+
     for (int i = 0; i < fQuickTransformResult.size(); i++)
     {
-        if (i == fQuickTransformResult.size() - 1)
+        if (i == topIndex)
         {
             if (std::abs(fQuickTransformResult[i] - fQuickEnergyValue) > 0.01)
             {
@@ -258,27 +501,1083 @@ bool Executor::calculateMonotonicity(std::size_t functionNumber, bool debug)
     return true;
 }
 
-std::vector<uint8_t> Executor::getLogicalFunction(std::size_t functionNumber)
+void Executor::preparePackedEngine()
 {
-    auto funcVectorSize = getMaxSetsCount();
+    int n = std::min(mVectorSpaceSize, MAX_PACKED_SIZE);
+    int vc = 1 << n;
 
-    std::vector<uint8_t> result;
-    result.resize(funcVectorSize);
+    mFunctionMask = vc == 64 ? ~0ULL : (1ULL << vc) - 1;
 
-    for (std::size_t i = 0; i < funcVectorSize; ++i)
+    // bit p of the function number holds f(vc - 1 - p), so input bit b is 1 exactly
+    // where bit b of p is 0
+    for (int b = 0; b < n; b++)
     {
-        result[funcVectorSize - i - 1] = (functionNumber >> i) & 1;
+        mCofactorMasks[b] = VARIABLE_MASKS[b] & mFunctionMask;
+
+        // alpha is given for x1..xn, x1 being the highest input bit
+        mIncreasing[b] = m_alphaSet[mVectorSpaceSize - b - 1] != 0;
     }
 
-    return result;
+    // variables above the word compare whole words of multiword tables
+    mHighDecreasing = false;
+
+    for (int b = n; b < mVectorSpaceSize; b++)
+    {
+        mIncreasing[b] = m_alphaSet[mVectorSpaceSize - b - 1] != 0;
+
+        // a 64-bit number covers only the low positions, the rest of the
+        // table is zero; decreasing in a high variable then forces f = 0
+        if (!mIncreasing[b])
+            mHighDecreasing = true;
+    }
+
+    mPackedCheck = PackedCheck();
+    mPackedCheck.bits = n;
+    mPackedCheck.functionMask = mFunctionMask;
+
+    for (int b = 0; b < n; b++)
+    {
+        (mIncreasing[b] ? mPackedCheck.increasing : mPackedCheck.decreasing)[b] = mCofactorMasks[b];
+        mPackedCheck.increasingBits |= (uint32_t)mIncreasing[b] << b;
+    }
+
+}
+
+void Executor::prepareMonotoneTable()
+{
+    if (mVectorSpaceSize > MAX_TABLE_SIZE)
+        return;
+
+    uint64_t total = 1ULL << (1 << mVectorSpaceSize);
+
+    // one spare word so range extraction can always read two words
+    mTables->monotoneTable.assign(total / 64 + 2, 0);
+
+    for (uint64_t i = 0; i < total; i++)
+    {
+        if (checkPacked(i))
+            mTables->monotoneTable[i / 64] |= 1ULL << (i % 64);
+    }
+}
+
+// f is monotone iff no cofactor with x_b = 0 exceeds the one with x_b = 1,
+// which for the function number is a shift by 2^b and a mask
+void Executor::preparePermutations()
+{
+    mTables->permutationCount = 1;
+
+    if (mVectorSpaceSize > MAX_PACKED_SIZE)
+        return;
+
+    int n = mVectorSpaceSize;
+
+    // swapping variables b and b + 1 moves positions with bit b set and bit
+    // b + 1 clear 2^b positions up, and the mirrored ones down
+    for (int b = 0; b + 1 < n; b++)
+        mTables->swapMasks[b] = ~VARIABLE_MASKS[b] & VARIABLE_MASKS[b + 1] & mFunctionMask;
+
+    // Steinhaus-Johnson-Trotter: n! - 1 adjacent swaps reach every order
+    std::vector<int> order(n), direction(n, -1);
+
+    for (int i = 0; i < n; i++)
+        order[i] = i;
+
+    while (true)
+    {
+        int mobile = -1;
+
+        for (int i = 0; i < n; i++)
+        {
+            int j = i + direction[order[i]];
+
+            if (j >= 0 && j < n && order[j] < order[i] && (mobile < 0 || order[i] > order[mobile]))
+                mobile = i;
+        }
+
+        if (mobile < 0)
+            break;
+
+        int value = order[mobile];
+        int j = mobile + direction[value];
+
+        std::swap(order[mobile], order[j]);
+        mTables->permutationSteps.push_back(std::min(mobile, j));
+
+        for (int i = 0; i < n; i++)
+        {
+            if (order[i] > value)
+                direction[order[i]] = -direction[order[i]];
+        }
+    }
+
+    for (int i = 2; i <= n; i++)
+        mTables->permutationCount *= i;
+}
+
+uint64_t Executor::canonicalize(uint64_t functionNumber, uint64_t *orbitSize) const
+{
+    uint64_t f = functionNumber & mFunctionMask;
+    uint64_t least = f, g = f, fixed = 1;
+
+    for (uint8_t b : mTables->permutationSteps)
+    {
+        int shift = 1 << b;
+        uint64_t mask = mTables->swapMasks[b];
+
+        g = (g & ~(mask | mask << shift)) | ((g & mask) << shift) | ((g >> shift) & mask);
+
+        least = std::min(least, g);
+        fixed += g == f;
+    }
+
+    // the permutations fixing f form a subgroup, its cosets are the orbit
+    if (orbitSize)
+        *orbitSize = mTables->permutationCount / fixed;
+
+    return least;
+}
+
+bool Executor::isCanonical(uint64_t functionNumber, uint64_t &orbitSize) const
+{
+    uint64_t g = functionNumber, fixed = 1;
+
+    for (uint8_t b : mTables->permutationSteps)
+    {
+        int shift = 1 << b;
+        uint64_t mask = mTables->swapMasks[b];
+
+        g = (g & ~(mask | mask << shift)) | ((g & mask) << shift) | ((g >> shift) & mask);
+
+        // most functions meet a smaller relabeling within a few swaps
+        if (g < functionNumber)
+            return false;
+
+        fixed += g == functionNumber;
+    }
+
+    orbitSize = mTables->permutationCount / fixed;
+    return true;
+}
+
+void Executor::enumerateCanonicalMonotone(widenum_t first, widenum_t last, const std::function<void(uint64_t, uint64_t)> &visit) const
+{
+    if (mVectorSpaceSize > MAX_PACKED_SIZE)
+        return;
+
+    enumerateMonotone(first, last, [&](widenum_t f) {
+        uint64_t orbitSize;
+
+        if (isCanonical((uint64_t)f, orbitSize))
+            visit((uint64_t)f, orbitSize);
+    });
+}
+
+void MonotoneStatistics::merge(const MonotoneStatistics &other)
+{
+    total += other.total;
+
+    for (std::size_t i = 0; i < byWeight.size(); i++)
+        byWeight[i] += other.byWeight[i];
+
+    for (std::size_t i = 0; i < byMinimalTerms.size(); i++)
+        byMinimalTerms[i] += other.byMinimalTerms[i];
+
+    for (std::size_t i = 0; i < byDegree.size(); i++)
+        byDegree[i] += other.byDegree[i];
+
+    for (std::size_t i = 0; i < byChunk.size(); i++)
+        byChunk[i] += other.byChunk[i];
+}
+
+void Executor::addStatistics(const uint64_t *functions, std::size_t count, std::size_t chunk, MonotoneStatistics &statistics) const
+{
+    uint8_t weights[STATISTICS_BATCH], minimalTerms[STATISTICS_BATCH], degrees[STATISTICS_BATCH];
+
+    mKernels->describe(mPackedCheck, functions, count, weights, minimalTerms, degrees);
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        statistics.byWeight[weights[i]]++;
+        statistics.byMinimalTerms[minimalTerms[i]]++;
+        statistics.byDegree[degrees[i]]++;
+    }
+
+    statistics.total += count;
+    statistics.byChunk[chunk] += count;
+}
+
+MonotoneStatistics Executor::collectStatistics(widenum_t first, widenum_t last, std::size_t chunkCount, unsigned threads) const
+{
+    MonotoneStatistics statistics;
+
+    if (mVectorSpaceSize > MAX_PACKED_SIZE || first > last || chunkCount == 0)
+        return statistics;
+
+    int n = mVectorSpaceSize;
+    uint64_t widestAntichain = 1;
+
+    for (int i = 0; i < n / 2; i++)
+        widestAntichain = widestAntichain * (n - i) / (i + 1);
+
+    statistics.first = first;
+    statistics.chunkSize = (last - first) / chunkCount + 1;
+    statistics.byWeight.assign((1 << n) + 1, 0);
+    statistics.byMinimalTerms.assign(widestAntichain + 1, 0);
+    statistics.byDegree.assign(n + 1, 0);
+    statistics.byChunk.assign((std::size_t)((last - first) / statistics.chunkSize) + 1, 0);
+
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    threads = std::min<std::size_t>(threads, statistics.byChunk.size());
+
+    std::atomic<std::size_t> nextChunk(0);
+    std::vector<MonotoneStatistics> partial(threads, statistics);
+    std::vector<std::thread> workers;
+
+    auto work = [&](MonotoneStatistics &own) {
+        for (std::size_t chunk; (chunk = nextChunk++) < own.byChunk.size();)
+        {
+            widenum_t start = first + chunk * own.chunkSize;
+            widenum_t end = chunk + 1 == own.byChunk.size() ? last : start + own.chunkSize - 1;
+
+            uint64_t functions[STATISTICS_BATCH];
+            std::size_t count = 0;
+
+            enumerateMonotone(start, end, [&](widenum_t f) {
+                functions[count++] = (uint64_t)f;
+
+                if (count == STATISTICS_BATCH)
+                {
+                    addStatistics(functions, count, chunk, own);
+                    count = 0;
+                }
+            });
+
+            addStatistics(functions, count, chunk, own);
+        }
+    };
+
+    for (unsigned i = 1; i < threads; i++)
+        workers.emplace_back(work, std::ref(partial[i]));
+
+    work(partial[0]);
+
+    for (auto &worker : workers)
+        worker.join();
+
+    for (auto &own : partial)
+        statistics.merge(own);
+
+    return statistics;
+}
+
+bool Executor::checkPacked(uint64_t functionNumber) const
+{
+    uint64_t f = functionNumber & mFunctionMask;
+
+    if (mHighDecreasing && f != 0)
+        return false;
+
+    for (int b = 0; b < std::min(mVectorSpaceSize, MAX_PACKED_SIZE); b++)
+    {
+        uint64_t shifted = f >> (1 << b);
+        uint64_t violations = mIncreasing[b] ? shifted & ~f : f & ~shifted;
+
+        if (violations & mCofactorMasks[b])
+            return false;
+    }
+
+    return true;
+}
+
+// Positions p and p + 2^b differ only in input bit b. When both lie above
+// the low bits and already break the order, every number that shares those
+// high bits does too.
+bool Executor::prefixFails(uint64_t functionNumber, int lowBits) const
+{
+    return ::prefixFails(functionNumber, std::min(mVectorSpaceSize, MAX_PACKED_SIZE), ~mPackedCheck.increasingBits, lowBits);
+}
+
+// Visits the monotone numbers of the aligned block of 2^bits numbers from
+// start that lie in [first, last]. A block whose prefix already fails is
+// dropped whole, the others are halved down to single bitmap words.
+bool Executor::enumerateBlock(uint64_t start, int bits, widenum_t first, widenum_t last, const std::function<bool(widenum_t)> &visit) const
+{
+    if (prefixFails(start, bits))
+        return true;
+
+    widenum_t end = start + ((widenum_t)1 << bits) - 1;
+
+    if (bits > 6)
+    {
+        uint64_t half = 1ULL << (bits - 1);
+
+        if (first < start + half && !enumerateBlock(start, bits - 1, first, last, visit))
+            return false;
+
+        if (last >= start + half)
+            return enumerateBlock(start + half, bits - 1, first, last, visit);
+
+        return true;
+    }
+
+    uint64_t from = (uint64_t)std::max<widenum_t>(first, start);
+    std::size_t count = std::min(last, end) - from + 1;
+    uint64_t bitmap;
+
+    calculateMonotonicityRange(from, count, &bitmap);
+
+    for (; bitmap; bitmap &= bitmap - 1)
+    {
+        if (!visit(from + __builtin_ctzll(bitmap)))
+            return false;
+    }
+
+    return true;
 }
 
-const bignum_t Executor::getMaxSetsCount() const
+bool Executor::calculateMonotonicity(const TruthTable &table) const
 {
-    return std::pow(2, mVectorSpaceSize);
+    const uint64_t *words = table.words();
+    std::size_t wordCount = table.wordCount();
+
+    if (mVectorSpaceSize <= MAX_PACKED_SIZE)
+        return checkPacked(words[0]);
+
+    if (!mKernels->checkWords(mPackedCheck, words, wordCount))
+        return false;
+
+    // variable b >= 6 pairs word k with word k + 2^(b - 6)
+    for (int b = MAX_PACKED_SIZE; b < mVectorSpaceSize; b++)
+    {
+        std::size_t stride = (std::size_t)1 << (b - MAX_PACKED_SIZE);
+
+        for (std::size_t k = 0; k < wordCount; k++)
+        {
+            if (k & stride)
+                continue;
+
+            uint64_t low = words[k], high = words[k + stride];
+
+            if (mIncreasing[b] ? high & ~low : low & ~high)
+                return false;
+        }
+    }
+
+    return true;
 }
 
-const bignum_t Executor::getTotalFunctionsCount() const
+// clears the directions violated between cofactors inside one word
+void Executor::restrictUnateness(uint64_t f, Unateness &unateness) const
 {
-    return std::pow(2, getMaxSetsCount());
+    for (int b = 0; b < std::min(mVectorSpaceSize, MAX_PACKED_SIZE); b++)
+    {
+        uint64_t shifted = f >> (1 << b);
+        uint32_t variable = 1u << (mVectorSpaceSize - b - 1);
+
+        if (shifted & ~f & mCofactorMasks[b])
+            unateness.increasing &= ~variable;
+
+        if (f & ~shifted & mCofactorMasks[b])
+            unateness.decreasing &= ~variable;
+    }
+}
+
+Unateness Executor::calculateUnateness(uint64_t functionNumber) const
+{
+    uint64_t f = functionNumber & mFunctionMask;
+
+    Unateness unateness;
+    unateness.increasing = (1u << mVectorSpaceSize) - 1;
+    unateness.decreasing = unateness.increasing;
+
+    restrictUnateness(f, unateness);
+
+    // the rest of a wider table is zero, which only allows increasing
+    // high variables unless f is zero
+    for (int b = MAX_PACKED_SIZE; b < mVectorSpaceSize && f != 0; b++)
+    {
+        unateness.decreasing &= ~(1u << (mVectorSpaceSize - b - 1));
+    }
+
+    return unateness;
+}
+
+Unateness Executor::calculateUnateness(const TruthTable &table) const
+{
+    const uint64_t *words = table.words();
+    std::size_t wordCount = table.wordCount();
+
+    if (mVectorSpaceSize <= MAX_PACKED_SIZE)
+        return calculateUnateness(words[0]);
+
+    Unateness unateness;
+    unateness.increasing = (1u << mVectorSpaceSize) - 1;
+    unateness.decreasing = unateness.increasing;
+
+    for (std::size_t k = 0; k < wordCount; k++)
+    {
+        restrictUnateness(words[k], unateness);
+    }
+
+    for (int b = MAX_PACKED_SIZE; b < mVectorSpaceSize; b++)
+    {
+        std::size_t stride = (std::size_t)1 << (b - MAX_PACKED_SIZE);
+        uint32_t variable = 1u << (mVectorSpaceSize - b - 1);
+
+        for (std::size_t k = 0; k < wordCount; k++)
+        {
+            if (k & stride)
+                continue;
+
+            uint64_t low = words[k], high = words[k + stride];
+
+            if (high & ~low)
+                unateness.increasing &= ~variable;
+
+            if (low & ~high)
+                unateness.decreasing &= ~variable;
+        }
+    }
+
+    return unateness;
+}
+
+// Every unate function is a monotone one with some variables negated, so
+// apply all 2^n negations to the monotone list and count distinct results.
+uint64_t Executor::countUnateFunctions() const
+{
+    if (mVectorSpaceSize > MAX_UNATE_COUNT_SIZE)
+        return 0;
+
+    int n = mVectorSpaceSize;
+
+    std::vector<uint64_t> monotone = listMonotoneFunctions(n);
+    std::vector<uint64_t> unate;
+    unate.reserve(monotone.size() << n);
+
+    for (uint32_t negated = 0; negated < (1u << n); negated++)
+    {
+        for (uint64_t f : monotone)
+        {
+            // negating x_b swaps the cofactors 2^b positions apart
+            for (int b = 0; b < n; b++)
+            {
+                if ((negated >> b) & 1)
+                {
+                    int shift = 1 << b;
+
+                    f = ((f & mCofactorMasks[b]) << shift) | ((f >> shift) & mCofactorMasks[b]);
+                }
+            }
+
+            unate.push_back(f);
+        }
+    }
+
+    std::sort(unate.begin(), unate.end());
+
+    return std::unique(unate.begin(), unate.end()) - unate.begin();
+}
+
+std::vector<uint64_t> Executor::listMonotoneFunctions(int size)
+{
+    // n = 0: both constants
+    std::vector<uint64_t> monotone = {0, 1};
+
+    // the high half of a function number is the cofactor x1 = 0, which must
+    // stay below the x1 = 1 cofactor in the low half
+    for (int n = 1; n <= std::min(size, MAX_PACKED_SIZE); n++)
+    {
+        int half = 1 << (n - 1);
+        std::vector<uint64_t> next;
+
+        for (uint64_t high : monotone)
+        {
+            for (uint64_t low : monotone)
+            {
+                if ((high & ~low) == 0)
+                    next.push_back(high << half | low);
+            }
+        }
+
+        monotone.swap(next);
+    }
+
+    return monotone;
+}
+
+void Executor::setStoreDirectory(const std::string &directory)
+{
+    mStoreDirectory = directory;
+    openStore();
+}
+
+void Executor::openStore()
+{
+    if (mStoreDirectory.empty() || mVectorSpaceSize > MAX_PACKED_SIZE)
+    {
+        mStore.close();
+        return;
+    }
+
+    std::string name = MonotoneStore::getFileName(mVectorSpaceSize, m_alphaSet);
+
+    mStore.open(mStoreDirectory + "/" + name, mVectorSpaceSize, m_alphaSet);
+}
+
+bool Executor::writeMonotoneStore(const std::string &directory, int size, const std::vector<int> &alpha)
+{
+    if (size > MAX_PACKED_SIZE || (int)alpha.size() != size)
+        return false;
+
+    std::vector<uint64_t> numbers = listMonotoneFunctions(size);
+
+    // alpha_i = 0 reverses input bit size - 1 - i, which swaps every
+    // position with bit b clear with the one 2^b above it
+    for (int i = 0; i < size; i++)
+    {
+        if (alpha[i])
+            continue;
+
+        int b = size - 1 - i;
+        int shift = 1 << b;
+        uint64_t low = VARIABLE_MASKS[b];
+
+        for (uint64_t &f : numbers)
+            f = ((f & low) << shift) | ((f >> shift) & low);
+    }
+
+    std::sort(numbers.begin(), numbers.end());
+
+    return MonotoneStore::write(directory + "/" + MonotoneStore::getFileName(size, alpha), size, alpha, numbers);
+}
+
+bool Executor::findMonotoneIndex(uint64_t functionNumber, uint64_t &index) const
+{
+    if (!mStore.isOpen())
+        return false;
+
+    uint64_t position = mStore.rank(functionNumber);
+
+    if (position >= mStore.count() || mStore.select(position) != functionNumber)
+        return false;
+
+    index = position;
+    return true;
+}
+
+bool Executor::getMonotoneFunction(uint64_t k, uint64_t &functionNumber) const
+{
+    if (!mStore.isOpen() || k >= mStore.count())
+        return false;
+
+    functionNumber = mStore.select(k);
+    return true;
+}
+
+bool Executor::rankMonotone(widenum_t functionNumber, uint64_t &k)
+{
+    if (mVectorSpaceSize > MAX_RANKING_SIZE || functionNumber > getLastFunctionNumber())
+        return false;
+
+    if (!std::all_of(mIncreasing, mIncreasing + mVectorSpaceSize, [](bool increasing) { return increasing; }))
+    {
+        if (mVectorSpaceSize > MAX_PACKED_SIZE || !checkPacked((uint64_t)functionNumber))
+            return false;
+
+        k = countBelowBlock(mVectorSpaceSize, 0, mFunctionMask, (uint64_t)functionNumber);
+        return true;
+    }
+
+    mRanking.prepare(mVectorSpaceSize);
+
+    uint64_t position = mRanking.rank(mVectorSpaceSize, functionNumber);
+
+    if (position >= mRanking.count(mVectorSpaceSize) || mRanking.unrank(mVectorSpaceSize, position) != functionNumber)
+        return false;
+
+    k = position;
+    return true;
+}
+
+bool Executor::unrankMonotone(uint64_t k, widenum_t &functionNumber)
+{
+    if (mVectorSpaceSize > MAX_RANKING_SIZE || k >= getMonotoneCount())
+        return false;
+
+    if (!std::all_of(mIncreasing, mIncreasing + mVectorSpaceSize, [](bool increasing) { return increasing; }))
+    {
+        if (mVectorSpaceSize > MAX_PACKED_SIZE)
+            return false;
+
+        functionNumber = selectBlock(mVectorSpaceSize, 0, mFunctionMask, k);
+        return true;
+    }
+
+    functionNumber = mRanking.unrank(mVectorSpaceSize, k);
+    return true;
+}
+
+uint64_t Executor::getMonotoneCount()
+{
+    if (mVectorSpaceSize > MAX_RANKING_SIZE)
+        return 0;
+
+    mRanking.prepare(mVectorSpaceSize);
+
+    return mRanking.count(mVectorSpaceSize);
+}
+
+void Executor::tightenInterval(uint64_t &lower, uint64_t &upper) const
+{
+    lower &= mFunctionMask;
+    upper &= mFunctionMask;
+
+    // closing along every variable once closes along all of them
+    for (int b = 0; b < mVectorSpaceSize; b++)
+    {
+        int shift = 1 << b;
+
+        if (mIncreasing[b])
+        {
+            lower |= (lower >> shift) & mCofactorMasks[b];
+            upper &= ~((~upper & mCofactorMasks[b]) << shift);
+        }
+        else
+        {
+            lower |= (lower & mCofactorMasks[b]) << shift;
+            upper &= ~((~upper >> shift) & mCofactorMasks[b]);
+        }
+    }
+}
+
+void Executor::enumerateIntervalBlock(int size, uint64_t lower, uint64_t upper, const std::function<void(uint64_t)> &visit) const
+{
+    if (lower & ~upper)
+        return;
+
+    if (lower == upper)
+    {
+        visit(lower);
+        return;
+    }
+
+    if (size == 0)
+    {
+        visit(0);
+        visit(1);
+        return;
+    }
+
+    int half = 1 << (size - 1);
+    uint64_t lowMask = (1ULL << half) - 1;
+    uint64_t lower0 = lower >> half, lower1 = lower & lowMask;
+    uint64_t upper0 = upper >> half, upper1 = upper & lowMask;
+
+    // the high half is the x_size = 0 cofactor, below the low half when increasing
+    if (mIncreasing[size - 1])
+    {
+        enumerateIntervalBlock(size - 1, lower0, upper0 & upper1, [&](uint64_t high) {
+            enumerateIntervalBlock(size - 1, lower1 | high, upper1, [&](uint64_t low) { visit(high << half | low); });
+        });
+    }
+    else
+    {
+        enumerateIntervalBlock(size - 1, lower0 | lower1, upper0, [&](uint64_t high) {
+            enumerateIntervalBlock(size - 1, lower1, upper1 & high, [&](uint64_t low) { visit(high << half | low); });
+        });
+    }
+}
+
+uint64_t Executor::countIntervalBlock(int size, uint64_t lower, uint64_t upper)
+{
+    if (lower & ~upper)
+        return 0;
+
+    if (lower == upper)
+        return 1;
+
+    if (size == 0)
+        return 2;
+
+    std::unordered_map<uint64_t, uint64_t> *counts = nullptr;
+    uint64_t key = 0;
+
+    // both bounds fit into one key below n = 6
+    if (size < MAX_PACKED_SIZE)
+    {
+        counts = &mTables->intervalCounts[size];
+        key = lower << (1 << size) | upper;
+
+        auto known = counts->find(key);
+
+        if (known != counts->end())
+            return known->second;
+    }
+
+    int half = 1 << (size - 1);
+    uint64_t lowMask = (1ULL << half) - 1;
+    uint64_t lower0 = lower >> half, lower1 = lower & lowMask;
+    uint64_t upper0 = upper >> half, upper1 = upper & lowMask;
+    uint64_t count = 0;
+
+    if (mIncreasing[size - 1])
+    {
+        enumerateIntervalBlock(size - 1, lower0, upper0 & upper1,
+                               [&](uint64_t high) { count += countIntervalBlock(size - 1, lower1 | high, upper1); });
+    }
+    else
+    {
+        enumerateIntervalBlock(size - 1, lower0 | lower1, upper0,
+                               [&](uint64_t high) { count += countIntervalBlock(size - 1, lower1, upper1 & high); });
+    }
+
+    if (counts)
+    {
+        if (counts->size() >= MAX_INTERVAL_COUNTS)
+            counts->clear();
+
+        (*counts)[key] = count;
+    }
+
+    return count;
+}
+
+// h < bound splits into a smaller high cofactor with any low one, or the
+// high cofactor of bound with a smaller low one
+uint64_t Executor::countBelowBlock(int size, uint64_t lower, uint64_t upper, uint64_t bound)
+{
+    if (lower & ~upper)
+        return 0;
+
+    if (lower == upper)
+        return lower < bound;
+
+    if (size == 0)
+        return bound == 1;
+
+    int half = 1 << (size - 1);
+    uint64_t lowMask = (1ULL << half) - 1;
+    uint64_t lower0 = lower >> half, lower1 = lower & lowMask;
+    uint64_t upper0 = upper >> half, upper1 = upper & lowMask;
+    uint64_t bound0 = bound >> half, bound1 = bound & lowMask;
+    bool increasing = mIncreasing[size - 1];
+    uint64_t count = 0;
+
+    enumerateIntervalBlock(size - 1, increasing ? lower0 : lower0 | lower1, increasing ? upper0 & upper1 : upper0, [&](uint64_t high) {
+        uint64_t low0 = increasing ? lower1 | high : lower1, low1 = increasing ? upper1 : upper1 & high;
+
+        if (high < bound0)
+            count += countIntervalBlock(size - 1, low0, low1);
+        else if (high == bound0)
+            count += countBelowBlock(size - 1, low0, low1, bound1);
+    });
+
+    return count;
+}
+
+uint64_t Executor::selectBlock(int size, uint64_t lower, uint64_t upper, uint64_t k)
+{
+    if (lower == upper)
+        return lower;
+
+    if (size == 0)
+        return k;
+
+    int half = 1 << (size - 1);
+    uint64_t lowMask = (1ULL << half) - 1;
+    uint64_t lower0 = lower >> half, lower1 = lower & lowMask;
+    uint64_t upper0 = upper >> half, upper1 = upper & lowMask;
+    bool increasing = mIncreasing[size - 1];
+    bool found = false;
+    uint64_t selected = 0;
+
+    enumerateIntervalBlock(size - 1, increasing ? lower0 : lower0 | lower1, increasing ? upper0 & upper1 : upper0, [&](uint64_t high) {
+        if (found)
+            return;
+
+        uint64_t low0 = increasing ? lower1 | high : lower1, low1 = increasing ? upper1 : upper1 & high;
+        uint64_t count = countIntervalBlock(size - 1, low0, low1);
+
+        if (k < count)
+        {
+            selected = high << half | selectBlock(size - 1, low0, low1, k);
+            found = true;
+        }
+        else
+        {
+            k -= count;
+        }
+    });
+
+    return selected;
+}
+
+uint64_t Executor::countInterval(uint64_t lower, uint64_t upper)
+{
+    if (mVectorSpaceSize > MAX_PACKED_SIZE)
+        return 0;
+
+    tightenInterval(lower, upper);
+
+    return countIntervalBlock(mVectorSpaceSize, lower, upper);
+}
+
+void Executor::enumerateInterval(uint64_t lower, uint64_t upper, const std::function<void(uint64_t)> &visit) const
+{
+    if (mVectorSpaceSize > MAX_PACKED_SIZE)
+        return;
+
+    tightenInterval(lower, upper);
+    enumerateIntervalBlock(mVectorSpaceSize, lower, upper, visit);
+}
+
+std::string toString(const Unateness &unateness, int size)
+{
+    if (!unateness.isUnate(size))
+        return "not unate";
+
+    std::string alpha = "alpha =";
+
+    for (int i = 0; i < size; i++)
+    {
+        uint32_t variable = 1u << i;
+        bool increasing = unateness.increasing & variable;
+        bool decreasing = unateness.decreasing & variable;
+
+        alpha += increasing && decreasing ? " *" : increasing ? " 1" : " 0";
+    }
+
+    return alpha;
+}
+
+bool Executor::checkTable(uint64_t functionNumber) const
+{
+    uint64_t f = functionNumber & mFunctionMask;
+
+    return (mTables->monotoneTable[f / 64] >> (f % 64)) & 1;
+}
+
+bool Executor::checkMonotonicity(bignum_t functionNumber, Engine engine)
+{
+    switch (engine)
+    {
+    case Engine::Table:
+        return checkTable(functionNumber);
+    case Engine::Packed:
+        return checkPacked(functionNumber);
+    case Engine::Store:
+        return mStore.isOpen() ? mStore.contains(functionNumber & mFunctionMask) : checkPacked(functionNumber);
+    default:
+        // the transform itself even when a store is mapped
+        if (mVectorSpaceSize > MAX_TRANSFORM_SIZE)
+            return calculateMonotonicity(TruthTable::fromNumber(functionNumber, mVectorSpaceSize));
+
+        return calculateTransform(functionNumber, false);
+    }
+}
+
+Engine Executor::getFastestEngine() const
+{
+    if (mVectorSpaceSize <= MAX_TABLE_SIZE)
+        return Engine::Table;
+
+    return Engine::Packed;
+}
+
+void Executor::calculateMonotonicityBatch(const uint64_t *numbers, std::size_t count, uint64_t *resultBitmap) const
+{
+    bool useTable = getFastestEngine() == Engine::Table;
+
+    if (!useTable && !mHighDecreasing)
+    {
+        mKernels->checkBatch(mPackedCheck, numbers, count, resultBitmap);
+        return;
+    }
+
+    for (std::size_t w = 0; w < (count + 63) / 64; w++)
+    {
+        std::size_t end = std::min<std::size_t>(count, w * 64 + 64);
+        uint64_t word = 0;
+
+        for (std::size_t i = w * 64; i < end; i++)
+        {
+            bool isMonotonous = useTable ? checkTable(numbers[i]) : checkPacked(numbers[i]);
+
+            word |= (uint64_t)isMonotonous << (i % 64);
+        }
+
+        resultBitmap[w] = word;
+    }
+}
+
+void Executor::calculateMonotonicityRange(uint64_t first, std::size_t count, uint64_t *resultBitmap) const
+{
+    uint64_t total = mFunctionMask + 1;
+
+    // inside the table a range is just a bit string, copy it word by word
+    if (getFastestEngine() == Engine::Table && total >= 64 && first < total && count <= total - first)
+    {
+        for (std::size_t w = 0; w < (count + 63) / 64; w++)
+        {
+            uint64_t offset = first + w * 64;
+            int shift = offset % 64;
+            uint64_t word = mTables->monotoneTable[offset / 64] >> shift;
+
+            if (shift)
+                word |= mTables->monotoneTable[offset / 64 + 1] << (64 - shift);
+
+            resultBitmap[w] = word;
+        }
+
+        if (count % 64)
+            resultBitmap[count / 64] &= (1ULL << (count % 64)) - 1;
+
+        return;
+    }
+
+    bool useTable = getFastestEngine() == Engine::Table;
+
+    if (!useTable && !mHighDecreasing)
+    {
+        mKernels->checkRange(mPackedCheck, first, count, resultBitmap);
+        return;
+    }
+
+    for (std::size_t w = 0; w < (count + 63) / 64; w++)
+    {
+        std::size_t end = std::min<std::size_t>(count, w * 64 + 64);
+        uint64_t word = 0;
+
+        for (std::size_t i = w * 64; i < end; i++)
+        {
+            bool isMonotonous = useTable ? checkTable(first + i) : checkPacked(first + i);
+
+            word |= (uint64_t)isMonotonous << (i % 64);
+        }
+
+        resultBitmap[w] = word;
+    }
+}
+
+void Executor::enumerateMonotone(widenum_t first, widenum_t last, const std::function<void(widenum_t)> &visit) const
+{
+    enumerateMonotoneWhile(first, last, [&](widenum_t f) {
+        visit(f);
+        return true;
+    });
+}
+
+void Executor::enumerateMonotoneWhile(widenum_t first, widenum_t last, const std::function<bool(widenum_t)> &visit) const
+{
+    last = std::min(last, getLastFunctionNumber());
+
+    if (first > last)
+        return;
+
+    if (mVectorSpaceSize > MAX_PACKED_SIZE)
+    {
+        for (widenum_t f = first;; f++)
+        {
+            if (calculateMonotonicity(TruthTable::fromNumber(f, mVectorSpaceSize)) && !visit(f))
+                return;
+
+            if (f == last)
+                return;
+        }
+    }
+
+    enumerateBlock(0, 1 << mVectorSpaceSize, first, last, visit);
+}
+
+MonotoneGenerator Executor::monotoneFunctions(widenum_t first, widenum_t last, std::size_t batchSize) const
+{
+    return MonotoneGenerator(this, first, std::min(last, getLastFunctionNumber()), batchSize);
+}
+
+MonotoneGenerator::MonotoneGenerator(const Executor *executor, widenum_t first, widenum_t last, std::size_t batchSize)
+    : mExecutor(executor), mNext(first), mLast(last), mBatchSize(std::max<std::size_t>(batchSize, 1)), mDone(first > last)
+{
+}
+
+bool MonotoneGenerator::next(std::vector<widenum_t> &batch)
+{
+    batch.clear();
+
+    if (mDone)
+        return false;
+
+    // restarting below mNext costs one descent, the pruning skips everything before it
+    mExecutor->enumerateMonotoneWhile(mNext, mLast, [&](widenum_t f) {
+        batch.push_back(f);
+        return batch.size() < mBatchSize;
+    });
+
+    if (batch.size() < mBatchSize || batch.back() == mLast)
+        mDone = true;
+    else
+        mNext = batch.back() + 1;
+
+    return !batch.empty();
+}
+
+MonotoneGenerator::iterator &MonotoneGenerator::iterator::operator++()
+{
+    if (++mPosition == mGenerator->mBatch.size())
+    {
+        mPosition = 0;
+
+        if (!mGenerator->next(mGenerator->mBatch))
+            mGenerator = nullptr;
+    }
+
+    return *this;
+}
+
+MonotoneGenerator::iterator MonotoneGenerator::begin()
+{
+    return next(mBatch) ? iterator(this) : iterator();
+}
+
+std::vector<uint8_t> Executor::getLogicalFunction(std::size_t functionNumber)
+{
+    auto funcVectorSize = getMaxSetsCount();
+
+    std::vector<uint8_t> result;
+    result.resize(funcVectorSize);
+
+    for (std::size_t i = 0; i < funcVectorSize; ++i)
+    {
+        result[funcVectorSize - i - 1] = (functionNumber >> i) & 1;
+    }
+
+    return result;
+}
+
+bignum_t Executor::getMaxSetsCount() const
+{
+    return 1ULL << mVectorSpaceSize;
+}
+
+int Executor::getVectorSpaceSize() const
+{
+    return mVectorSpaceSize;
+}
+
+widenum_t Executor::getTotalFunctionsCount() const
+{
+    if (mVectorSpaceSize > MAX_PACKED_SIZE)
+        return 0;
+
+    return (widenum_t)1 << getMaxSetsCount();
+}
+
+widenum_t Executor::getLastFunctionNumber() const
+{
+    if (mVectorSpaceSize >= MAX_NUMBER_SIZE)
+        return ~(widenum_t)0;
+
+    return getTotalFunctionsCount() - 1;
 }
\ No newline at end of file
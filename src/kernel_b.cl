@@ -0,0 +1,79 @@
+#pragma OPENCL EXTENSION cl_khr_int64_base_atomics : enable
+
+// Bit-parallel variant of kernel_m.cl: the whole truth table stays in the
+// function number itself and every check is a handful of shifts and masks, so
+// no private arrays are needed. Built with the same -D N, DECREASING and
+// SELF_DUAL defines as kernel_m.cl.
+#ifndef N
+#error "build with -D N=<number of variables>"
+#endif
+
+#ifndef DECREASING
+#define DECREASING 0
+#endif
+
+#define VC (1 << N)
+
+// every position of the table, 2^64 - 1 for n = 6
+#define TABLE_MASK (VC == 64 ? ~0UL : (1UL << (VC & 63)) - 1)
+
+// positions p of the function number with bit j of p clear, where input
+// bit j of x = vc - 1 - p is set
+__constant const static ulong VARIABLE_MASKS[] = {
+    0x5555555555555555UL, 0x3333333333333333UL, 0x0F0F0F0F0F0F0F0FUL,
+    0x00FF00FF00FF00FFUL, 0x0000FFFF0000FFFFUL, 0x00000000FFFFFFFFUL};
+
+// Bit p holds f(vc - 1 - p) and p + 2^j is p with input bit j cleared, so f
+// is increasing in bit j when no bit at p + 2^j exceeds the one at p, and
+// decreasing when none is below it. Together these are the cofactor
+// comparisons f|x=0 <= f|x=1 for every variable.
+bool isMonotone(ulong nf) {
+  for (int j = 0; j < N; j++) {
+    ulong neighbour = nf >> (1 << j);
+    ulong broken = (DECREASING >> j) & 1 ? nf & ~neighbour : neighbour & ~nf;
+
+    if (broken & VARIABLE_MASKS[j])
+      return false;
+  }
+
+  return true;
+}
+
+// f(~x) is the table reversed, which swaps p with p ^ 2^j for every j;
+// self-dual means the reversed table is the complement
+bool isDual(ulong nf) {
+  ulong reversed = nf;
+
+  for (int j = 0; j < N; j++) {
+    ulong s = 1 << j;
+    reversed = ((reversed & VARIABLE_MASKS[j]) << s) |
+               ((reversed >> s) & VARIABLE_MASKS[j]);
+  }
+
+  return reversed == (~nf & TABLE_MASK);
+}
+
+// same arguments and counters as kernel_m.cl
+__kernel void compute(__global ulong *result, ulong offset, ulong count,
+                      __global ulong *hitCount, __global ulong *hits,
+                      uint capacity, uint slot) {
+  if (get_global_id(0) >= count)
+    return;
+
+  ulong nf = offset + get_global_id(0); // function number
+
+#ifdef SELF_DUAL
+  if (!isDual(nf))
+    return;
+#endif
+
+  if (!isMonotone(nf))
+    return;
+
+  atom_add(result + slot, 1);
+
+  ulong hit = atom_inc(hitCount);
+
+  if (hit < capacity)
+    hits[hit] = nf;
+}
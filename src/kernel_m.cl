@@ -1,7 +1,19 @@
 #pragma OPENCL EXTENSION cl_khr_global_int32_base_atomics : enable
 #pragma OPENCL EXTENSION cl_khr_int64_base_atomics : enable
 
-#define MAX_FUNCTION_LENGTH 64
+// Built by cltest with -D N=<n>, so every loop over the vc values has a fixed
+// trip count and the arrays below have the exact size. DECREASING has bit j set
+// when f must be decreasing in input bit j (alpha = 0), SELF_DUAL only counts
+// self-dual functions.
+#ifndef N
+#error "build with -D N=<number of variables>"
+#endif
+
+#ifndef DECREASING
+#define DECREASING 0
+#endif
+
+#define VC (1 << N)
 
 // #define DEBUG 1
 
@@ -12,28 +24,55 @@ __constant const static ulong POWERS_OF_2_TABLE[] = {
     256,   512,    1024,   2048,   4096,    8192,   16384, 32768,
     65536, 131072, 262144, 524288, 1048576, 2097152};
 
-__kernel void compute(__global int *N, __global int *result,
-                      __global ulong *offset, __global int *dualCount,
-                      __global ulong *hist) {
+// positions p of the function number with bit j of p clear, where input
+// bit j of x = vc - 1 - p is set
+__constant const static ulong VARIABLE_MASKS[] = {
+    0x5555555555555555UL, 0x3333333333333333UL, 0x0F0F0F0F0F0F0F0FUL,
+    0x00FF00FF00FF00FFUL, 0x0000FFFF0000FFFFUL, 0x00000000FFFFFFFFUL};
+
+// g(x) = f(x ^ DECREASING) is increasing exactly when f is monotone for alpha;
+// flipping input bit j swaps every position p with p ^ 2^j
+ulong orient(ulong nf) {
+  for (int j = 0; j < N; j++) {
+    if ((DECREASING >> j) & 1) {
+      ulong s = POWERS_OF_2_TABLE[j];
+      nf = ((nf & VARIABLE_MASKS[j]) << s) | ((nf >> s) & VARIABLE_MASKS[j]);
+    }
+  }
+
+  return nf;
+}
+
+// result holds one counter per chunk of the host window, slot picks ours. Hits
+// are appended to hits: atom_inc reserves the slot, and the ones past capacity
+// are only counted so the host can tell the list overflowed. The launch is
+// rounded up to whole work-groups, items past count have nothing to check.
+__kernel void compute(__global ulong *result, ulong offset, ulong count,
+                      __global ulong *hitCount, __global ulong *hits,
+                      uint capacity, uint slot) {
+  if (get_global_id(0) >= count)
+    return;
+
   // Get our global thread ID
-  ulong nf = *offset + get_global_id(0); // function number
+  ulong number = offset + get_global_id(0); // function number
+  ulong nf = orient(number);
 
 #ifdef DEBUG
   if (nf != 11)
     return;
-  printf("nf = %lu, N = %d\n", nf, *N);
+  printf("nf = %lu, N = %d\n", nf, N);
 #endif
 
-  ulong vc = POWERS_OF_2_TABLE[*N]; // vector count
+  ulong vc = VC; // vector count
 
 #ifdef DEBUG
   printf("vc = %lu", vc);
 #endif
 
-  BF f[MAX_FUNCTION_LENGTH];  // base function
-  BF fd[MAX_FUNCTION_LENGTH]; // direct transform
-  BF fi[MAX_FUNCTION_LENGTH]; // inverse transform
-  BF fr[MAX_FUNCTION_LENGTH]; // result function
+  BF f[VC];  // base function
+  BF fd[VC]; // direct transform
+  BF fi[VC]; // inverse transform
+  BF fr[VC]; // result function
 
   int energy = 0; // energy determines the criteria for the function
 
@@ -76,9 +115,11 @@ __kernel void compute(__global int *N, __global int *result,
     energy += value * value;
   }
 
+#ifdef SELF_DUAL
   if (!isDual) {
     return;
   }
+#endif
 
 #ifdef DEBUG
   printf("f = ");
@@ -94,7 +135,7 @@ __kernel void compute(__global int *N, __global int *result,
   printf("Perf with %d, %d\n", n);
 #endif
 
-  int n = *N; // amount of variables or size of function
+  int n = N; // amount of variables or size of function
 
   ulong vhalf = POWERS_OF_2_TABLE[n - 1]; // half of loop
 
@@ -105,8 +146,8 @@ __kernel void compute(__global int *N, __global int *result,
          POWERS_OF_2_TABLE[n]);
 #endif
 
-  BF fo[MAX_FUNCTION_LENGTH];  // buffer for direct
-  BF foi[MAX_FUNCTION_LENGTH]; // buffer for inverse
+  BF fo[VC];  // buffer for direct
+  BF foi[VC]; // buffer for inverse
 
 #if 1
   for (int i = 0; i < n; i++) {
@@ -180,14 +221,10 @@ __kernel void compute(__global int *N, __global int *result,
 #endif
 
   // if we got here, then we have a monotonic function
-  atomic_add(result, 1);
+  atom_add(result + slot, 1);
 
-  if (isDual) {
-    hist[*dualCount] = nf;
-    atomic_add(dualCount, 1);
-  }
+  ulong hit = atom_inc(hitCount);
 
-  // for (int i = 0; i < vc; i++) {
-  //   atomic_add(hist + i, f[i]);
-  // }
+  if (hit < capacity)
+    hits[hit] = number;
 }
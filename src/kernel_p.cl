@@ -0,0 +1,194 @@
+#pragma OPENCL EXTENSION cl_khr_global_int32_base_atomics : enable
+#pragma OPENCL EXTENSION cl_khr_int64_base_atomics : enable
+
+// built with the same -D N, DECREASING and SELF_DUAL defines as kernel_m.cl
+#ifndef N
+#error "build with -D N=<number of variables>"
+#endif
+
+#ifndef DECREASING
+#define DECREASING 0
+#endif
+
+#define VC (1 << N)
+
+typedef char BF;
+
+__constant const static ulong POWERS_OF_2_TABLE[] = {
+    1,     2,      4,      8,      16,      32,     64,    128,
+    256,   512,    1024,   2048,   4096,    8192,   16384, 32768,
+    65536, 131072, 262144, 524288, 1048576, 2097152};
+
+// positions p of the function number with bit j of p clear, where input bit
+// j of x = vc - 1 - p is set; p + 2^j is the neighbour with it cleared
+__constant const static ulong VARIABLE_MASKS[] = {
+    0x5555555555555555UL, 0x3333333333333333UL, 0x0F0F0F0F0F0F0F0FUL,
+    0x00FF00FF00FF00FFUL, 0x0000FFFF0000FFFFUL, 0x00000000FFFFFFFFUL};
+
+// True when the bits of nf from position lowBits up already break
+// monotonicity, whatever the lowBits low bits hold. Bit p holds f(vc - 1 - p),
+// so for increasing f the bit at p + 2^j may not exceed the bit at p, and for
+// decreasing f it may not be below it.
+bool prefixFails(ulong nf, int lowBits) {
+  ulong fixed = lowBits < 64 ? ~((1UL << lowBits) - 1) : 0;
+
+  for (int j = 0; j < N; j++) {
+    ulong neighbour = nf >> POWERS_OF_2_TABLE[j];
+    ulong broken = (DECREASING >> j) & 1 ? nf & ~neighbour : neighbour & ~nf;
+
+    if (broken & VARIABLE_MASKS[j] & fixed)
+      return true;
+  }
+
+  return false;
+}
+
+// g(x) = f(x ^ DECREASING) is increasing exactly when f is monotone for alpha;
+// flipping input bit j swaps every position p with p ^ 2^j
+ulong orient(ulong nf) {
+  for (int j = 0; j < N; j++) {
+    if ((DECREASING >> j) & 1) {
+      ulong s = POWERS_OF_2_TABLE[j];
+      nf = ((nf & VARIABLE_MASKS[j]) << s) | ((nf >> s) & VARIABLE_MASKS[j]);
+    }
+  }
+
+  return nf;
+}
+
+bool isDual(ulong nf) {
+  for (int i = 0; i < VC / 2; i++) {
+    if (((nf >> i) & 1) == ((nf >> (VC - i - 1)) & 1))
+      return false;
+  }
+
+  return true;
+}
+
+// same criterion as kernel_m.cl: the product of the direct and inverse
+// transforms is zero everywhere but the last position, which holds the energy;
+// nf has to be oriented to increasing already
+bool isMonotone(ulong nf) {
+  int n = N;
+  ulong vc = VC; // vector count
+
+  BF fd[VC]; // direct transform
+  BF fi[VC]; // inverse transform
+
+  int energy = 0;
+
+  // quick monotonicity checks on f(1...1) and f(0...0)
+  if ((nf & 1) == 0 && nf != 0)
+    return false;
+  if ((nf >> (vc - 1)) & 1 && nf != (vc == 64 ? ~0UL : (1UL << vc) - 1))
+    return false;
+
+  for (ulong i = 0; i < vc; i++) {
+    BF value = (nf >> i) & 1;
+
+    fd[vc - i - 1] = value;
+    fi[vc - i - 1] = value;
+
+    energy += value;
+  }
+
+  int vhalf = POWERS_OF_2_TABLE[n - 1]; // half of loop
+  int npower = vc;                      // power of 2 for n
+
+  BF fo[VC];  // buffer for direct
+  BF foi[VC]; // buffer for inverse
+
+  for (int i = 0; i < n; i++) {
+    // copy last iteration
+    for (int j = 0; j < vc; j++) {
+      fo[j] = fd[j];
+      foi[j] = fi[j];
+    }
+    for (int j = 0; j < vc; j++) {
+      int jd = j << 1; // j * 2
+
+      // according to formulas
+      if (j < vhalf) {
+        fd[j] = fo[jd];
+        fi[j] = foi[jd] - foi[jd + 1];
+      } else {
+        fd[j] = fo[jd - npower] + fo[jd - npower + 1];
+        fi[j] = foi[jd - npower + 1];
+      }
+    }
+  }
+
+  for (int i = 0; i < vc - 1; i++) {
+    if (fd[i] * fi[i] != 0)
+      return false;
+  }
+
+  return fd[vc - 1] * fi[vc - 1] == energy;
+}
+
+// Persistent variant of kernel_m.cl: every work-item walks an aligned block of
+// `block` function numbers (a power of two) and counts privately. Counts are
+// summed in local memory, so a work-group does a single global atomic. While
+// walking, the largest aligned sub-block whose fixed high bits already fail is
+// skipped as a whole. result counts every monotone function (self-dual only
+// with SELF_DUAL), each of them is appended to hits as in kernel_m.cl.
+__kernel void compute(__global ulong *result, ulong offset, ulong count,
+                      __global ulong *hitCount, __global ulong *hits,
+                      uint capacity, uint slot, uint block,
+                      __local ulong *counts) {
+  // positions are relative to offset, so the last chunk ending at 2^64 does
+  // not wrap; blocks of the tail are cut at count
+  ulong first = get_global_id(0) * (ulong)block;
+  ulong last = min(first + block, count);
+
+  ulong found = 0;
+
+  for (ulong i = first; i < last;) {
+    ulong nf = offset + i;
+
+    // i - first is a multiple of this power of two, and so is the block
+    ulong done = i - first;
+    int bits = 63 - clz(done ? done & -done : (ulong)block);
+
+    while (bits > 0 && !prefixFails(nf, bits))
+      bits--;
+
+    if (bits > 0) {
+      i += 1UL << bits;
+      continue;
+    }
+
+#ifdef SELF_DUAL
+    if (!isDual(nf)) {
+      i++;
+      continue;
+    }
+#endif
+
+    if (isMonotone(orient(nf))) {
+      found++;
+
+      ulong hit = atom_inc(hitCount);
+
+      if (hit < capacity)
+        hits[hit] = nf;
+    }
+
+    i++;
+  }
+
+  uint lid = get_local_id(0);
+  uint size = get_local_size(0);
+
+  counts[lid] = found;
+
+  for (uint stride = 1; stride < size; stride <<= 1) {
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (lid % (2 * stride) == 0 && lid + stride < size)
+      counts[lid] += counts[lid + stride];
+  }
+
+  if (lid == 0 && counts[0])
+    atom_add(result + slot, counts[0]);
+}
@@ -4,17 +4,98 @@
 #include <algorithm>
 #include <iterator>
 #include <chrono>
+#include <cstdlib>
 #include <sstream>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include <batch.hpp>
 #include <executor.hpp>
 
-int main() {
+// "--build-store dir" writes every orientation up to n = 5 and the default
+// one of n = 6 (63 MB each); "--build-store dir n alpha_1 ... alpha_n" one store
+static int buildStores(const std::string& directory, int argc, char* argv[]) {
+    std::vector<std::pair<int, std::vector<int>>> stores;
+
+    if (argc == 0) {
+        for (int n = 0; n < MAX_PACKED_SIZE; n++) {
+            for (int a = 0; a < (1 << n); a++) {
+                std::vector<int> alpha(n);
+
+                for (int i = 0; i < n; i++) alpha[i] = (a >> (n - 1 - i)) & 1;
+
+                stores.push_back({n, alpha});
+            }
+        }
+
+        stores.push_back({MAX_PACKED_SIZE, std::vector<int>(MAX_PACKED_SIZE, 1)});
+    } else {
+        int n = std::atoi(argv[0]);
+
+        if (n < 0 || n > MAX_PACKED_SIZE || (argc != 1 && argc != n + 1)) {
+            std::cerr << "Stores hold n = 0.." << MAX_PACKED_SIZE << " with one alpha digit per variable" << std::endl;
+            return 2;
+        }
+
+        std::vector<int> alpha(n, 1);
+
+        for (int i = 1; i < argc; i++) alpha[i - 1] = std::atoi(argv[i]) != 0;
+
+        stores.push_back({n, alpha});
+    }
+
+    mkdir(directory.c_str(), 0755);
+
+    for (auto& store : stores) {
+        if (!Executor::writeMonotoneStore(directory, store.first, store.second)) {
+            std::cerr << "Error writing " << directory << "/" << MonotoneStore::getFileName(store.first, store.second) << std::endl;
+            return 1;
+        }
+
+        std::cout << directory << "/" << MonotoneStore::getFileName(store.first, store.second) << std::endl;
+    }
+
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    std::string storeDirectory;
+    std::string cacheDirectory;
+    const char* batchPath = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+
+        if (option == "--batch" && i + 1 < argc) {
+            batchPath = argv[++i];
+        } else if (option == "--store" && i + 1 < argc) {
+            storeDirectory = argv[++i];
+        } else if (option == "--cache" && i + 1 < argc) {
+            cacheDirectory = argv[++i];
+        } else if (option == "--build-store" && i + 1 < argc) {
+            return buildStores(argv[i + 1], argc - i - 2, argv + i + 2);
+        } else {
+            std::cerr << "usage: qmf [--store dir] [--cache dir] [--batch file|-]\n       qmf --build-store dir [n [alpha_1 ... alpha_n]]" << std::endl;
+            return 2;
+        }
+    }
+
+    if (batchPath) {
+        Executor executor(false);
+        executor.setStoreDirectory(storeDirectory);
+        executor.setCacheDirectory(cacheDirectory);
+        return runBatch(&executor, batchPath);
+    }
+
     bool isStdinTerminal = isatty(0);
 
-    if (isStdinTerminal) std::cout << "qmf, checks boolean function for monotonicity.\nFor changing amount of variables, type @n\nFor exiting, type 'exit'" << std::endl;
+    if (isStdinTerminal) std::cout << "qmf, checks boolean function for monotonicity.\nFor changing amount of variables, type @n\nFor the orientations making f monotone, type ?f\nFor the monotone functions between f and g, type [f g] or $[f g] to list them\nFor writing all monotone functions into a results file, type $>file\nFor the least relabeling of f and its orbit size, type =f, or $= to list the canonical monotone functions\nFor histograms of the monotone functions by weight, minimal terms, degree and chunk, type $%\nFor exiting, type 'exit'" << std::endl;
 
     Executor* executor = new Executor();
+    executor->setStoreDirectory(storeDirectory);
+    executor->setCacheDirectory(cacheDirectory);
+
+    if (isStdinTerminal) std::cout << "Vector routines: " << toString(executor->getCpuLevel()) << " (QMF_CPU=generic|avx2 lowers them)" << std::endl;
 
     bool inDebug = false;
 
@@ -23,7 +104,7 @@ int main() {
 
         std::string input;
 
-        std::getline(std::cin, input);
+        if (!std::getline(std::cin, input)) break;
 
         if (input.length() == 0 || input[0] == '\n') continue;
 
@@ -43,6 +124,11 @@ int main() {
 
             ss >> new_size;
 
+            if (new_size < 0 || new_size > MAX_VECTOR_SPACE_SIZE) {
+                std::cout << "n must be between 0 and " << MAX_VECTOR_SPACE_SIZE << std::endl;
+                continue;
+            }
+
             int* alpha = nullptr;
 
             int pos = 0;
@@ -67,37 +153,180 @@ int main() {
 
             executor->changeVectorSpaceSize(new_size, alpha);
 
-            delete alpha;
+            delete[] alpha;
 
             std::cout << "n = " << new_size << std::endl;
             continue;
         }
 
+        if (input[0] == '?') {
+            std::string query = input.substr(1);
+            int n = executor->getVectorSpaceSize();
+
+            if (query == "$") {
+                if (n > MAX_UNATE_COUNT_SIZE) {
+                    std::cout << "Unate functions are only counted up to n = " << MAX_UNATE_COUNT_SIZE << std::endl;
+                    continue;
+                }
+
+                auto begin = std::chrono::high_resolution_clock::now();
+
+                uint64_t unateCount = executor->countUnateFunctions();
+
+                auto end = std::chrono::high_resolution_clock::now();
+
+                std::cout << "Unate functions count for given vector space: " << unateCount << std::endl;
+                std::cout << "Time spent: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << " ms" << std::endl;
+                continue;
+            }
+
+            TruthTable table;
+
+            if (!TruthTable::parse(query, n, table)) {
+                std::cout << "Expected ?f or ?$" << std::endl;
+                continue;
+            }
+
+            std::cout << toString(executor->calculateUnateness(table), n) << std::endl;
+            continue;
+        }
+
+        if (input[0] == '=') {
+            int n = executor->getVectorSpaceSize();
+            TruthTable table;
+
+            if (n > MAX_PACKED_SIZE || !TruthTable::parse(input.substr(1), n, table)) {
+                std::cout << "Expected =f with n <= " << MAX_PACKED_SIZE << std::endl;
+                continue;
+            }
+
+            uint64_t orbitSize = 0;
+            uint64_t canonical = executor->canonicalize((uint64_t)table.toNumber(), &orbitSize);
+
+            std::cout << canonical << " (orbit size " << orbitSize << ")" << std::endl;
+            continue;
+        }
+
+        if (input == "$=") {
+            if (executor->getVectorSpaceSize() > MAX_PACKED_SIZE) {
+                std::cout << "Canonical functions are only listed up to n = " << MAX_PACKED_SIZE << std::endl;
+                continue;
+            }
+
+            auto begin = std::chrono::high_resolution_clock::now();
+
+            uint64_t canonicalCount = 0, monotonicCount = 0;
+
+            executor->enumerateCanonicalMonotone(0, executor->getLastFunctionNumber(), [&](uint64_t f, uint64_t orbitSize) {
+                canonicalCount++;
+                monotonicCount += orbitSize;
+                std::cout << f << " " << orbitSize << "\n";
+            });
+
+            auto end = std::chrono::high_resolution_clock::now();
+
+            std::cout << "Canonical monotonic functions count: " << canonicalCount << std::endl;
+            std::cout << "Monotonic functions in their orbits: " << monotonicCount << std::endl;
+            std::cout << "Time spent: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << " ms" << std::endl;
+            continue;
+        }
+
+        if (input[0] == '[' || input.compare(0, 2, "$[") == 0) {
+            bool list = input[0] == '$';
+            uint64_t lower = 0, upper = 0;
+
+            if (!parseInterval(input.substr(list ? 1 : 0), executor->getVectorSpaceSize(), lower, upper)) {
+                std::cout << "Expected [f g] or $[f g] with n <= " << MAX_PACKED_SIZE << std::endl;
+                continue;
+            }
+
+            auto begin = std::chrono::high_resolution_clock::now();
+
+            if (list) executor->enumerateInterval(lower, upper, [](uint64_t h) { std::cout << h << "\n"; });
+
+            uint64_t count = executor->countInterval(lower, upper);
+
+            auto end = std::chrono::high_resolution_clock::now();
+
+            std::cout << "Monotone functions in the interval: " << count << std::endl;
+            std::cout << "Time spent: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << " ms" << std::endl;
+            continue;
+        }
+
+        if (input == "$%") {
+            if (executor->getVectorSpaceSize() > MAX_PACKED_SIZE) {
+                std::cout << "Statistics are only collected up to n = " << MAX_PACKED_SIZE << std::endl;
+                continue;
+            }
+
+            auto begin = std::chrono::high_resolution_clock::now();
+
+            MonotoneStatistics statistics = executor->collectStatistics(0, executor->getLastFunctionNumber());
+
+            auto end = std::chrono::high_resolution_clock::now();
+
+            std::cout << formatStatistics(statistics);
+            std::cout << "Time spent: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << " ms" << std::endl;
+            continue;
+        }
+
+        if (input.compare(0, 2, "$>") == 0) {
+            // above n = 6 every number is checked on its own, 2^128 of them at n = 7
+            if (executor->getVectorSpaceSize() > MAX_PACKED_SIZE) {
+                std::cout << "Monotone functions are only listed up to n = " << MAX_PACKED_SIZE << std::endl;
+                continue;
+            }
+
+            std::string target = input.substr(2);
+
+            target.erase(0, target.find_first_not_of(" \t"));
+
+            auto begin = std::chrono::high_resolution_clock::now();
+
+            uint64_t count = 0;
+
+            if (!writeMonotoneList(executor, target, count)) {
+                std::cout << "Cannot write " << target << std::endl;
+                continue;
+            }
+
+            auto end = std::chrono::high_resolution_clock::now();
+
+            std::cout << "Monotonic functions count for given vector space: " << count << std::endl;
+            std::cout << "Written to " << target << std::endl;
+            std::cout << "Time spent: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << " ms" << std::endl;
+            continue;
+        }
+
         if (input[0] == '$') {
-            std::cout << "Total functions count to iterate: " << executor->getTotalFunctionsCount() << std::endl;
+            if (executor->getVectorSpaceSize() > MAX_PACKED_SIZE) {
+                std::cout << "Monotone functions are only listed up to n = " << MAX_PACKED_SIZE << std::endl;
+                continue;
+            }
+
+            widenum_t last = executor->getLastFunctionNumber();
+
+            std::cout << "Total functions count to iterate: " << toString(executor->getTotalFunctionsCount()) << std::endl;
 
             auto begin = std::chrono::high_resolution_clock::now();
 
             std::size_t monotonicCount = 0;
 
-            int lastPrintedPercent = 0;
+            int percentPrecision = last >= 65536 ? 1 : 10;
 
-            int percentPrecision = executor->getTotalFunctionsCount() > 65536 ? 1 : 10;
+            for (int percent = 0; percent < 100; percent += percentPrecision) {
+                bool isLastSlice = percent + percentPrecision >= 100;
+                widenum_t first = last / 100 * percent;
+                widenum_t next = last / 100 * (percent + percentPrecision);
 
-            for (std::size_t i = 0; i < executor->getTotalFunctionsCount(); i++) {
-                int percent = (i * 100) / executor->getTotalFunctionsCount();
+                if (!isLastSlice && next == first) continue;
 
-                if (percent % percentPrecision == 0 && percent != lastPrintedPercent) {
-                    std::cout << percent << "% => " << i << "\n";
-                    lastPrintedPercent = percent;
-                }
-
-                bool isMonotonous = executor->calculateMonotonicity(i);
+                if (percent != 0 && first != 0) std::cout << percent << "% => " << toString(first) << "\n";
 
-                if (isMonotonous) {
+                executor->enumerateMonotone(first, isLastSlice ? last : next - 1, [&](widenum_t f) {
                     monotonicCount++;
-                    std::cout << i << std::endl;
-                }
+                    std::cout << toString(f) << "\n";
+                });
             }
 
             auto end = std::chrono::high_resolution_clock::now();
@@ -110,9 +339,17 @@ int main() {
             continue;
         }
 
-        std::size_t functionNumber = std::stoul(input);
+        TruthTable table;
+
+        if (!TruthTable::parse(input, executor->getVectorSpaceSize(), table)) {
+            std::cout << "Expected a function number or 0x-prefixed truth table of n = " << executor->getVectorSpaceSize() << std::endl;
+            continue;
+        }
 
-        bool isMonotonous = executor->calculateMonotonicity(functionNumber, inDebug);
+        // small tables keep going through the transform for its debug output
+        bool isMonotonous = executor->getVectorSpaceSize() <= MAX_TRANSFORM_SIZE
+                                ? executor->calculateMonotonicity(table.words()[0], inDebug)
+                                : executor->calculateMonotonicity(table);
 
         std::cout << (isMonotonous ? "Yes" : "No") << std::endl;
     }
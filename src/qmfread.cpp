@@ -0,0 +1,99 @@
+#include <iostream>
+#include <string>
+
+#include <results.hpp>
+#include <truthtable.hpp>
+
+// Prints a results file written by qmf ($>file) or cltest (--results file).
+static void printUsage() {
+    std::cerr << "usage: qmfread file [--functions [first [last]]] [--chunks] [--csv] [--verify]" << std::endl;
+}
+
+static void printSummary(const ResultReader& reader) {
+    std::cout << "n = " << reader.size() << ", alpha =";
+
+    for (int a : reader.alpha()) std::cout << " " << a;
+
+    std::cout << "\nFunctions: " << reader.count() << "\nChunks: " << reader.chunks().size() << std::endl;
+
+    for (auto& entry : reader.metadata()) std::cout << entry.first << ": " << entry.second << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printUsage();
+        return 2;
+    }
+
+    ResultReader reader;
+
+    if (!reader.open(argv[1])) {
+        std::cerr << "qmfread: " << argv[1] << " is no readable results file" << std::endl;
+        return 1;
+    }
+
+    if (argc == 2) {
+        printSummary(reader);
+        return 0;
+    }
+
+    std::string option = argv[2];
+
+    if (option == "--functions" && argc <= 5) {
+        widenum_t first = 0, last = ~(widenum_t)0;
+
+        if ((argc > 3 && !parseNumber(argv[3], first)) || (argc > 4 && !parseNumber(argv[4], last))) {
+            printUsage();
+            return 2;
+        }
+
+        std::string buffer;
+
+        bool read = reader.readFunctions(first, last, [&](widenum_t f) {
+            buffer += toString(f);
+            buffer += '\n';
+
+            if (buffer.size() >= 1 << 20) {
+                std::cout << buffer;
+                buffer.clear();
+            }
+        });
+
+        std::cout << buffer;
+
+        if (!read) {
+            std::cerr << "qmfread: corrupt function block" << std::endl;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    if ((option == "--chunks" || option == "--csv") && argc == 3) {
+        // the same lines cltest logs and the CSV to_csv.js makes of them
+        widenum_t total = reader.chunks().empty() ? 0 : reader.chunks().back().end;
+
+        if (option == "--csv") std::cout << "offset,count\n";
+
+        for (auto& chunk : reader.chunks()) {
+            if (option == "--csv") {
+                std::cout << toString(chunk.offset) << "," << chunk.count << "\n";
+            } else {
+                std::cout << "Chunk (" << toString(chunk.offset) << " , " << toString(chunk.end) << ", "
+                          << (double)chunk.end / (double)total * 100 << "%) => " << chunk.count << "\n";
+            }
+        }
+
+        return 0;
+    }
+
+    if (option == "--verify" && argc == 3) {
+        bool intact = reader.verify();
+
+        std::cout << (intact ? "OK" : "Corrupt") << std::endl;
+        return intact ? 0 : 1;
+    }
+
+    printUsage();
+    return 2;
+}
@@ -0,0 +1,1667 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <batch.hpp>
+#include <cofactors.hpp>
+#include <executor.hpp>
+#include <results.hpp>
+
+// Regression harness: runs every engine over the full function space for
+// small n and compares against known counts and the recorded n=5 runs.
+
+// Dedekind numbers, OEIS A000372 (see a000372_3.pdf)
+const bignum_t DEDEKIND_NUMBERS[] = {2, 3, 6, 20, 168, 7581, 7828354};
+
+// n = 7, only counted by the ranking tables
+const uint64_t DEDEKIND_7 = 2414682040998ULL;
+
+// self-dual monotone functions, OEIS A001206
+const bignum_t SELF_DUAL_MONOTONE_COUNTS[] = {0, 1, 2, 4, 12, 81, 2646};
+
+// monotone functions up to permutation of the variables, OEIS A003182
+const bignum_t INEQUIVALENT_MONOTONE_COUNTS[] = {2, 3, 5, 10, 30, 210, 16353};
+
+// unate functions, OEIS A003183
+const bignum_t UNATE_COUNTS[] = {2, 4, 14, 104, 2170, 230540, 499596550};
+
+// chunk size used by cltest for n=5 runs (5.csv, solution_5.txt)
+const bignum_t CHUNK_SIZE_5 = 16777216;
+
+// sweeps below this size finish too quickly to time reliably
+const bignum_t MIN_TIMED_SWEEP = 65536;
+
+const int MAX_N = 6;
+
+// sweeps hand out blocks of this many function numbers to the engines
+const std::size_t SWEEP_BLOCK = 4096;
+
+// blocks a sampled sweep checks, for n too large to sweep in full; fast engines
+// go over them again until the timing covers this many seconds
+const int SAMPLED_BLOCKS = 256;
+const double MIN_SAMPLED_SECONDS = 0.5;
+
+struct TestEngine
+{
+    const char *name;
+    int maxN;        // largest n the engine can sweep in reasonable time
+    int maxSampledN; // largest n it answers at all, sampled above maxN
+    // sets bit i of bitmap when first + i is monotone
+    void (*checkRange)(Executor &executor, bignum_t first, std::size_t count, uint64_t *bitmap);
+};
+
+template <Engine engine>
+void checkEach(Executor &executor, bignum_t first, std::size_t count, uint64_t *bitmap)
+{
+    std::fill(bitmap, bitmap + (count + 63) / 64, 0);
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        if (executor.checkMonotonicity(first + i, engine))
+            bitmap[i / 64] |= 1ULL << (i % 64);
+    }
+}
+
+void checkBatch(Executor &executor, bignum_t first, std::size_t count, uint64_t *bitmap)
+{
+    std::vector<uint64_t> numbers(count);
+
+    for (std::size_t i = 0; i < count; i++)
+        numbers[i] = first + i;
+
+    executor.calculateMonotonicityBatch(numbers.data(), count, bitmap);
+}
+
+void checkBatchRange(Executor &executor, bignum_t first, std::size_t count, uint64_t *bitmap)
+{
+    executor.calculateMonotonicityRange(first, count, bitmap);
+}
+
+const TestEngine ENGINES[] = {
+    {"transform", 4, MAX_TRANSFORM_SIZE, checkEach<Engine::Transform>},
+    {"table", MAX_TABLE_SIZE, MAX_TABLE_SIZE, checkEach<Engine::Table>},
+    {"packed", 5, MAX_PACKED_SIZE, checkEach<Engine::Packed>},
+    {"batch", 5, MAX_PACKED_SIZE, checkBatch},
+    {"batch-range", 5, MAX_PACKED_SIZE, checkBatchRange},
+};
+
+struct SweepResult
+{
+    bignum_t monotoneCount;
+    bignum_t selfDualCount;
+    std::vector<bignum_t> chunkCounts;
+    std::vector<bignum_t> selfDualFunctions;
+    double functionsPerSecond;
+};
+
+struct Options
+{
+    std::string dataDir = ".";
+    std::string engine;
+    int maxN = MAX_N;
+    double tolerance = 0.5;
+    bool updateBaseline = false;
+};
+
+int failures = 0;
+
+void report(bool ok, const std::string &message)
+{
+    std::cout << (ok ? "[  OK  ] " : "[ FAIL ] ") << message << std::endl;
+
+    if (!ok)
+        failures++;
+}
+
+void skip(const std::string &message)
+{
+    std::cout << "[ SKIP ] " << message << std::endl;
+}
+
+// xorshift64, the same sequence from a seed on every run
+uint64_t nextRandom(uint64_t &state)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// alpha_i = i % 2, the mixed orientation the checks use besides alpha = 1
+std::vector<int> mixedAlpha(int n)
+{
+    std::vector<int> alpha(n);
+
+    for (int i = 0; i < n; i++)
+        alpha[i] = i % 2;
+
+    return alpha;
+}
+
+// runs check for alpha = 1, then for the mixed alpha of n
+void forEachAlpha(int n, const std::function<void(std::vector<int> alpha, bool mixed)> &check)
+{
+    check(std::vector<int>(n, 1), false);
+    check(mixedAlpha(n), true);
+}
+
+SweepResult sweep(const TestEngine &engine, Executor &executor, int n)
+{
+    SweepResult r;
+    r.monotoneCount = 0;
+    r.selfDualCount = 0;
+
+    bignum_t total = executor.getTotalFunctionsCount();
+    bignum_t chunkSize = n == 5 ? CHUNK_SIZE_5 : total;
+
+    r.chunkCounts.assign(total / chunkSize, 0);
+
+    auto begin = std::chrono::high_resolution_clock::now();
+
+    uint64_t bitmap[SWEEP_BLOCK / 64];
+
+    for (bignum_t first = 0; first < total; first += SWEEP_BLOCK)
+    {
+        std::size_t count = std::min<bignum_t>(SWEEP_BLOCK, total - first);
+
+        engine.checkRange(executor, first, count, bitmap);
+
+        for (std::size_t w = 0; w < (count + 63) / 64; w++)
+        {
+            for (uint64_t bits = bitmap[w]; bits; bits &= bits - 1)
+            {
+                bignum_t i = first + w * 64 + __builtin_ctzll(bits);
+
+                r.monotoneCount++;
+                r.chunkCounts[i / chunkSize]++;
+
+                if (isSelfDual(i, n))
+                {
+                    r.selfDualCount++;
+                    r.selfDualFunctions.push_back(i);
+                }
+            }
+        }
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - begin).count();
+
+    r.functionsPerSecond = seconds > 0 ? total / seconds : 0;
+
+    return r;
+}
+
+// first numbers of the blocks a sampled sweep checks: every other one holds a
+// monotone function picked evenly by rank, so the check is not all rejections;
+// the rest start at random
+std::vector<uint64_t> sampleBlocks(Executor &executor)
+{
+    std::vector<uint64_t> blocks;
+    uint64_t count = executor.getMonotoneCount();
+    uint64_t last = (uint64_t)executor.getLastFunctionNumber() - 2 * SWEEP_BLOCK + 1;
+    uint64_t state = 88172645463325252ULL;
+
+    for (int i = 0; i < SAMPLED_BLOCKS; i++)
+    {
+        widenum_t f = nextRandom(state);
+
+        if (i % 2 == 0)
+            executor.unrankMonotone(count / SAMPLED_BLOCKS * i + i, f);
+
+        blocks.push_back(std::min((uint64_t)f, last) & ~(uint64_t)(SWEEP_BLOCK - 1));
+    }
+
+    return blocks;
+}
+
+// sweep over the given blocks only, no chunk counts; the counts are those of
+// the first pass
+SweepResult sampledSweep(const TestEngine &engine, Executor &executor, int n, const std::vector<uint64_t> &blocks)
+{
+    SweepResult r;
+    r.monotoneCount = 0;
+    r.selfDualCount = 0;
+
+    auto begin = std::chrono::high_resolution_clock::now();
+    double seconds = 0;
+    int passes = 0;
+
+    uint64_t bitmap[SWEEP_BLOCK / 64];
+
+    do
+    {
+        for (uint64_t first : blocks)
+        {
+            engine.checkRange(executor, first, SWEEP_BLOCK, bitmap);
+
+            if (passes > 0)
+                continue;
+
+            for (std::size_t w = 0; w < SWEEP_BLOCK / 64; w++)
+            {
+                for (uint64_t bits = bitmap[w]; bits; bits &= bits - 1)
+                {
+                    r.monotoneCount++;
+                    r.selfDualCount += isSelfDual(first + w * 64 + __builtin_ctzll(bits), n);
+                }
+            }
+        }
+
+        passes++;
+        seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - begin).count();
+    } while (seconds < MIN_SAMPLED_SECONDS);
+
+    r.functionsPerSecond = (double)passes * blocks.size() * SWEEP_BLOCK / seconds;
+
+    return r;
+}
+
+// what a sampled sweep should find, from the enumeration
+void countSampled(Executor &executor, int n, const std::vector<uint64_t> &blocks, bignum_t &monotoneCount, bignum_t &selfDualCount)
+{
+    monotoneCount = 0;
+    selfDualCount = 0;
+
+    for (uint64_t first : blocks)
+    {
+        executor.enumerateMonotone(first, first + SWEEP_BLOCK - 1, [&](widenum_t f) {
+            monotoneCount++;
+            selfDualCount += isSelfDual((uint64_t)f, n);
+        });
+    }
+}
+
+// 5.csv: offset,count per chunk, converted from solution_5.txt by to_csv.js
+bool loadChunkCsv(const std::string &path, std::vector<bignum_t> &counts)
+{
+    std::ifstream file(path);
+
+    if (!file)
+        return false;
+
+    std::string line;
+    std::getline(file, line); // header
+
+    while (std::getline(file, line))
+    {
+        auto comma = line.find(',');
+
+        if (comma == std::string::npos)
+            continue;
+
+        bignum_t offset = std::stoull(line.substr(0, comma));
+
+        if (offset != counts.size() * CHUNK_SIZE_5)
+            return false;
+
+        counts.push_back(std::stoull(line.substr(comma + 1)));
+    }
+
+    return true;
+}
+
+// solution_5.txt: raw cltest log, "Chunk (offset , end, percent%) => count"
+bool loadChunkLog(const std::string &path, std::vector<bignum_t> &counts)
+{
+    std::ifstream file(path);
+
+    if (!file)
+        return false;
+
+    std::string line;
+
+    while (std::getline(file, line))
+    {
+        if (line.compare(0, 7, "Chunk (") != 0)
+            continue;
+
+        auto arrow = line.find("=>");
+
+        if (arrow == std::string::npos)
+            return false;
+
+        counts.push_back(std::stoull(line.substr(arrow + 2)));
+    }
+
+    return true;
+}
+
+// hist.csv: self-dual monotone n=5 function numbers dumped by cltest
+bool loadSelfDualList(const std::string &path, std::vector<bignum_t> &functions)
+{
+    std::ifstream file(path);
+
+    if (!file)
+        return false;
+
+    std::string line;
+    std::getline(file, line); // header
+
+    while (std::getline(file, line))
+    {
+        auto comma = line.find(',');
+
+        if (comma == std::string::npos)
+            continue;
+
+        bignum_t value = std::stoull(line.substr(comma + 1));
+
+        // unused slots of the 256-entry buffer stay zero
+        if (value != 0)
+            functions.push_back(value);
+    }
+
+    std::sort(functions.begin(), functions.end());
+
+    return true;
+}
+
+// smallest monotone function above the seed vectors: closes the set of ones
+// upwards one variable at a time (x_b = 1 sits 2^b positions lower)
+uint64_t upwardClosure(uint64_t seeds, int n)
+{
+    for (int b = 0; b < n; b++)
+        seeds |= (seeds >> (1 << b)) & VARIABLE_MASKS[b];
+
+    return seeds;
+}
+
+// a random monotone function of n <= 6 variables, sparse seeds keep it away
+// from the constant 1
+uint64_t nextRandomMonotone(uint64_t &state, int n)
+{
+    return upwardClosure(nextRandom(state) & nextRandom(state) & nextRandom(state), n);
+}
+
+// multiword engine against the single-word one at n=6, and at n=7 against
+// the cofactor rule: f = (f0, f1) is monotone iff both halves are and f0 <= f1
+void checkMultiword(Executor &executor)
+{
+    const int samples = 100000;
+
+    uint64_t state = 88172645463325252ULL;
+
+    executor.changeVectorSpaceSize(6);
+
+    report(executor.getTotalFunctionsCount() == (widenum_t)1 << 64, "n=6: total functions count is exactly 2^64");
+
+    int mismatches = 0;
+
+    for (int i = 0; i < samples; i++)
+    {
+        uint64_t f = i % 2 ? nextRandomMonotone(state, 6) : nextRandom(state);
+
+        if (executor.calculateMonotonicity(TruthTable::fromNumber(f, 6)) != executor.checkMonotonicity(f, Engine::Packed))
+            mismatches++;
+    }
+
+    report(mismatches == 0, "multiword n=6: agrees with packed on " + std::to_string(samples) + " tables");
+
+    executor.changeVectorSpaceSize(7);
+
+    report(executor.getLastFunctionNumber() == ~(widenum_t)0, "n=7: last function number is exactly 2^128 - 1");
+
+    mismatches = 0;
+
+    for (int i = 0; i < samples; i++)
+    {
+        uint64_t low = nextRandomMonotone(state, 6);
+        uint64_t high = i % 2 ? low & nextRandom(state) : nextRandomMonotone(state, 6);
+
+        if (i % 3 == 0)
+            high ^= 1ULL << (nextRandom(state) % 64);
+
+        executor.changeVectorSpaceSize(6);
+
+        bool expected = (high & ~low) == 0 && executor.checkMonotonicity(high, Engine::Packed) &&
+                        executor.checkMonotonicity(low, Engine::Packed);
+
+        executor.changeVectorSpaceSize(7);
+
+        TruthTable table = TruthTable::fromNumber((widenum_t)high << 64 | low, 7);
+
+        if (executor.calculateMonotonicity(table) != expected)
+            mismatches++;
+
+        TruthTable parsed;
+
+        if (!TruthTable::parse(table.toHex(), 7, parsed) || !(parsed == table) ||
+            !TruthTable::parse(table.toString(), 7, parsed) || !(parsed == table))
+            mismatches++;
+    }
+
+    report(mismatches == 0, "multiword n=7: agrees with the cofactor rule and round-trips hex and decimal");
+}
+
+// every alpha set: transform and packed engines agree, the shared prefix test
+// with no free bits rejects exactly the non-monotone numbers, and each
+// orientation has as many monotone functions as the default one; unateness
+// found in one pass matches the orientation-wise count
+void checkOrientations(Executor &executor, int maxN)
+{
+    for (int n = 0; n <= std::min(maxN, 4); n++)
+    {
+        bignum_t total = 1ULL << (1 << n);
+        bool agree = true;
+
+        for (int a = 0; a < (1 << n); a++)
+        {
+            int alpha[4];
+            uint32_t decreasing = 0;
+
+            for (int i = 0; i < n; i++)
+            {
+                alpha[i] = (a >> i) & 1;
+
+                if (alpha[i] == 0)
+                    decreasing |= 1U << (n - 1 - i);
+            }
+
+            executor.changeVectorSpaceSize(n, alpha);
+
+            bignum_t count = 0;
+
+            for (bignum_t f = 0; f < total; f++)
+            {
+                bool isMonotonous = executor.checkMonotonicity(f, Engine::Packed);
+
+                if (n <= 3 && isMonotonous != executor.checkMonotonicity(f, Engine::Transform))
+                    agree = false;
+
+                if (prefixFails(f, n, decreasing, 0) == isMonotonous)
+                    agree = false;
+
+                count += isMonotonous;
+            }
+
+            if (count != DEDEKIND_NUMBERS[n])
+                agree = false;
+        }
+
+        report(agree, "alpha n=" + std::to_string(n) + ": every orientation gives the Dedekind number, transform and prefix test agree");
+
+        bignum_t unateCount = 0;
+
+        for (bignum_t f = 0; f < total; f++)
+            unateCount += executor.calculateUnateness(f).isUnate(n);
+
+        report(unateCount == UNATE_COUNTS[n], "unateness n=" + std::to_string(n) + ": " + std::to_string(unateCount) + " unate, expected " + std::to_string(UNATE_COUNTS[n]));
+    }
+
+    for (int n = 0; n <= std::min(maxN, MAX_UNATE_COUNT_SIZE); n++)
+    {
+        executor.changeVectorSpaceSize(n);
+
+        bignum_t unateCount = executor.countUnateFunctions();
+
+        report(unateCount == UNATE_COUNTS[n], "unate count n=" + std::to_string(n) + ": " + std::to_string(unateCount) + ", expected " + std::to_string(UNATE_COUNTS[n]));
+    }
+}
+
+// the cofactor-pair generator is the one engine that reaches n=6 exhaustively
+void checkGenerated(int maxN)
+{
+    for (int n = 0; n <= maxN; n++)
+    {
+        std::vector<uint64_t> monotone = Executor::listMonotoneFunctions(n);
+
+        bignum_t selfDualCount = 0;
+
+        for (uint64_t f : monotone)
+            selfDualCount += isSelfDual(f, n);
+
+        std::string tag = "generated n=" + std::to_string(n);
+
+        report(monotone.size() == DEDEKIND_NUMBERS[n] && std::is_sorted(monotone.begin(), monotone.end()),
+               tag + ": " + std::to_string(monotone.size()) + " monotone, expected " + std::to_string(DEDEKIND_NUMBERS[n]));
+        report(selfDualCount == SELF_DUAL_MONOTONE_COUNTS[n],
+               tag + ": " + std::to_string(selfDualCount) + " self-dual, expected " + std::to_string(SELF_DUAL_MONOTONE_COUNTS[n]));
+    }
+}
+
+// enumerateMonotone skips blocks with a failing prefix; it must still find
+// exactly the generated list, from unaligned bounds and in every orientation
+void checkEnumeration(Executor &executor, int maxN)
+{
+    for (int n = 0; n <= maxN; n++)
+    {
+        executor.changeVectorSpaceSize(n);
+
+        std::vector<uint64_t> found;
+        widenum_t last = executor.getLastFunctionNumber();
+
+        // odd bounds so that slices start and end inside blocks
+        for (int slice = 0; slice < 7; slice++)
+        {
+            widenum_t first = last / 7 * slice + (slice != 0);
+            widenum_t end = slice == 6 ? last : last / 7 * (slice + 1);
+
+            executor.enumerateMonotone(first, end, [&](widenum_t f) { found.push_back((uint64_t)f); });
+        }
+
+        std::string tag = "enumerate n=" + std::to_string(n);
+
+        report(found == Executor::listMonotoneFunctions(n), tag + ": " + std::to_string(found.size()) + " monotone, expected " + std::to_string(DEDEKIND_NUMBERS[n]));
+
+        // pulled in batches that end inside blocks, and one by one from an odd start
+        MonotoneGenerator generator = executor.monotoneFunctions(0, last, 1000);
+        std::vector<widenum_t> batch;
+        std::vector<uint64_t> pulled;
+        bool bounded = true;
+
+        while (generator.next(batch))
+        {
+            bounded = bounded && batch.size() <= 1000;
+            pulled.insert(pulled.end(), batch.begin(), batch.end());
+        }
+
+        widenum_t start = last / 3 + 1;
+        std::vector<uint64_t> iterated;
+
+        for (widenum_t f : executor.monotoneFunctions(start, last, 7))
+            iterated.push_back((uint64_t)f);
+
+        report(bounded && pulled == found && iterated == std::vector<uint64_t>(std::lower_bound(found.begin(), found.end(), start), found.end()),
+               "generator n=" + std::to_string(n) + ": batches and range-for match the enumeration");
+
+        if (n == 0 || n > 5)
+            continue;
+
+        std::vector<int> alpha = mixedAlpha(n);
+
+        executor.changeVectorSpaceSize(n, alpha.data());
+
+        bignum_t count = 0;
+        executor.enumerateMonotone(0, last, [&](widenum_t f) { count += executor.checkMonotonicity((bignum_t)f, Engine::Packed); });
+
+        report(count == DEDEKIND_NUMBERS[n], tag + " alpha 0101...: " + std::to_string(count) + " monotone, expected " + std::to_string(DEDEKIND_NUMBERS[n]));
+    }
+}
+
+// stores written to a scratch directory answer like the packed engine:
+// membership, index and k-th function, for the default and a mixed alpha
+void checkStore(Executor &executor, int maxN)
+{
+    char directory[] = "/tmp/qmftest-store-XXXXXX";
+
+    if (!mkdtemp(directory))
+    {
+        report(false, "store: scratch directory");
+        return;
+    }
+
+    std::vector<std::string> written;
+
+    for (int n = 0; n <= maxN; n++)
+    {
+        forEachAlpha(n, [&](std::vector<int> alpha, bool mixed) {
+            if (mixed && n == MAX_PACKED_SIZE)
+                return;
+
+            std::string tag = "store n=" + std::to_string(n) + (mixed ? " alpha 0101..." : "");
+
+            if (!Executor::writeMonotoneStore(directory, n, alpha))
+            {
+                report(false, tag + ": written");
+                return;
+            }
+
+            written.push_back(std::string(directory) + "/" + MonotoneStore::getFileName(n, alpha));
+
+            executor.setStoreDirectory(directory);
+            executor.changeVectorSpaceSize(n, alpha.data());
+
+            std::vector<uint64_t> monotone;
+            executor.enumerateMonotone(0, executor.getLastFunctionNumber(), [&](widenum_t f) { monotone.push_back((uint64_t)f); });
+
+            bool agree = executor.hasStore();
+            uint64_t k = 0, f = 0;
+
+            // every function of small n, a spread of them beyond
+            uint64_t step = n <= 4 ? 1 : executor.getLastFunctionNumber() / 100003;
+
+            for (uint64_t i = 0; agree && i <= executor.getLastFunctionNumber() / step; i++)
+            {
+                uint64_t number = i * step;
+
+                agree = executor.calculateMonotonicity(number) == executor.checkMonotonicity(number, Engine::Packed);
+
+                // the transform engine is still computed, not looked up
+                if (agree && n <= 4)
+                    agree = executor.checkMonotonicity(number, Engine::Transform) == executor.checkMonotonicity(number, Engine::Packed);
+            }
+
+            for (std::size_t i = 0; agree && i < monotone.size(); i += n < MAX_PACKED_SIZE ? 1 : 997)
+            {
+                bool nextIsMonotone = i + 1 < monotone.size() && monotone[i + 1] == monotone[i] + 1;
+
+                agree = executor.findMonotoneIndex(monotone[i], k) && k == i && executor.getMonotoneFunction(i, f) && f == monotone[i] &&
+                        (monotone[i] == ~0ULL || executor.findMonotoneIndex(monotone[i] + 1, k) == nextIsMonotone);
+            }
+
+            agree = agree && !executor.getMonotoneFunction(monotone.size(), f);
+
+            report(agree, tag + ": membership, index, k-th and the transform agree with the packed engine");
+
+            // counted ranks are the store's indices in every orientation
+            for (std::size_t i = 0; agree && i < monotone.size(); i++)
+            {
+                uint64_t rank = 0;
+
+                agree = executor.rankMonotone(monotone[i], rank) && executor.findMonotoneIndex(monotone[i], k) && rank == k;
+            }
+
+            report(agree, tag + ": ranks match the store's indices");
+        });
+    }
+
+    executor.setStoreDirectory("");
+
+    for (auto &path : written)
+        std::remove(path.c_str());
+
+    rmdir(directory);
+}
+
+void checkRanking(Executor &executor, int maxN)
+{
+    for (int n = 0; n <= maxN; n++)
+    {
+        forEachAlpha(n, [&](std::vector<int> alpha, bool mixed) {
+            std::string tag = "ranking n=" + std::to_string(n) + (mixed ? " alpha 0101..." : "");
+
+            executor.changeVectorSpaceSize(n, alpha.data());
+
+            std::vector<uint64_t> monotone;
+            executor.enumerateMonotone(0, executor.getLastFunctionNumber(), [&](widenum_t f) { monotone.push_back((uint64_t)f); });
+
+            bool agree = executor.getMonotoneCount() == monotone.size();
+
+            for (std::size_t i = 0; agree && i < monotone.size(); i += n < MAX_PACKED_SIZE ? 1 : 997)
+            {
+                uint64_t k = 0;
+                widenum_t f = 0;
+
+                agree = executor.unrankMonotone(i, f) && executor.checkMonotonicity((uint64_t)f, Engine::Packed) &&
+                        executor.rankMonotone(f, k) && k == i && f == monotone[i];
+
+                if (agree && monotone[i] < executor.getLastFunctionNumber())
+                    agree = executor.rankMonotone(monotone[i] + 1, k) == executor.checkMonotonicity(monotone[i] + 1, Engine::Packed);
+            }
+
+            widenum_t f = 0;
+            agree = agree && !executor.unrankMonotone(monotone.size(), f);
+
+            report(agree, tag + ": rank and unrank follow the function-number order");
+        });
+    }
+
+    if (maxN < MAX_N)
+        return;
+
+    executor.changeVectorSpaceSize(MAX_PACKED_SIZE + 1);
+
+    uint64_t count = executor.getMonotoneCount();
+    bool agree = count == DEDEKIND_7;
+    widenum_t previous = 0;
+
+    for (uint64_t k = 0; agree && k < count; k += count / 1000 + 7)
+    {
+        widenum_t f = 0;
+        uint64_t position = 0;
+
+        agree = executor.unrankMonotone(k, f) && (k == 0 || f > previous) &&
+                executor.calculateMonotonicity(TruthTable::fromNumber(f, MAX_PACKED_SIZE + 1)) && executor.rankMonotone(f, position) &&
+                position == k;
+        previous = f;
+    }
+
+    widenum_t last = 0;
+    agree = agree && executor.unrankMonotone(count - 1, last) && last == executor.getLastFunctionNumber();
+
+    report(agree, "ranking n=7: " + std::to_string(count) + " monotone, ranks of a spread of them round trip");
+
+    std::vector<int> alpha = mixedAlpha(MAX_PACKED_SIZE + 1);
+    uint64_t position = 0;
+
+    executor.changeVectorSpaceSize(MAX_PACKED_SIZE + 1, alpha.data());
+
+    report(!executor.unrankMonotone(0, last) && !executor.rankMonotone(0, position),
+           "ranking n=7 alpha 0101...: refused, the tables only cover alpha = 1");
+}
+
+// interval queries against filtering the full enumeration, with random and
+// with monotone bounds
+void checkInterval(Executor &executor, int maxN)
+{
+    uint64_t state = 88172645463325252ULL;
+
+    for (int n = 0; n <= std::min(maxN, MAX_PACKED_SIZE - 1); n++)
+    {
+        forEachAlpha(n, [&](std::vector<int> alpha, bool mixed) {
+            executor.changeVectorSpaceSize(n, alpha.data());
+
+            std::vector<uint64_t> monotone;
+            executor.enumerateMonotone(0, executor.getLastFunctionNumber(), [&](widenum_t f) { monotone.push_back((uint64_t)f); });
+
+            uint64_t mask = (uint64_t)executor.getLastFunctionNumber();
+            bool agree = true;
+
+            for (int i = 0; agree && i < 200; i++)
+            {
+                uint64_t lower = nextRandom(state) & mask, upper = nextRandom(state) & mask;
+
+                if (i % 2)
+                {
+                    lower = monotone[nextRandom(state) % monotone.size()];
+                    upper = monotone[nextRandom(state) % monotone.size()];
+                }
+
+                std::vector<uint64_t> expected, found;
+
+                for (uint64_t h : monotone)
+                {
+                    if ((lower & ~h) == 0 && (h & ~upper) == 0)
+                        expected.push_back(h);
+                }
+
+                executor.enumerateInterval(lower, upper, [&](uint64_t h) { found.push_back(h); });
+
+                agree = found == expected && executor.countInterval(lower, upper) == expected.size();
+            }
+
+            report(agree, "interval n=" + std::to_string(n) + (mixed ? " alpha 0101..." : "") + ": agrees with the filtered enumeration");
+        });
+    }
+
+    if (maxN < MAX_PACKED_SIZE)
+        return;
+
+    executor.changeVectorSpaceSize(MAX_PACKED_SIZE);
+
+    bool agree = executor.countInterval(0, ~0ULL) == DEDEKIND_NUMBERS[MAX_PACKED_SIZE];
+
+    for (int i = 0; agree && i < 200; i++)
+    {
+        uint64_t a = nextRandomMonotone(state, MAX_PACKED_SIZE);
+        uint64_t b = upwardClosure(nextRandom(state) & nextRandom(state), MAX_PACKED_SIZE);
+        uint64_t lower = a & b, upper = a | b, previous = 0, found = 0;
+
+        executor.enumerateInterval(lower, upper, [&](uint64_t h) {
+            agree = agree && (found == 0 || h > previous) && (lower & ~h) == 0 && (h & ~upper) == 0 &&
+                    executor.checkMonotonicity(h, Engine::Packed);
+            previous = h;
+            found++;
+        });
+
+        agree = agree && executor.countInterval(lower, upper) == found;
+    }
+
+    report(agree, "interval n=6: the whole lattice and random intervals count what they enumerate");
+}
+
+// f with its position bits, and so its variables, reordered by order
+uint64_t permuteVariables(uint64_t f, const std::vector<int> &order)
+{
+    int n = order.size();
+    uint64_t g = 0;
+
+    for (int p = 0; p < (1 << n); p++)
+    {
+        int q = 0;
+
+        for (int b = 0; b < n; b++)
+            q |= ((p >> b) & 1) << order[b];
+
+        g |= ((f >> p) & 1) << q;
+    }
+
+    return g;
+}
+
+// canonical forms: brute force over all orders for small n, the OEIS counts of
+// inequivalent monotone functions, orbit sizes adding up to Dedekind numbers
+void checkCanonical(Executor &executor, int maxN)
+{
+    for (int n = 0; n <= std::min(maxN, 4); n++)
+    {
+        executor.changeVectorSpaceSize(n);
+
+        uint64_t last = (uint64_t)executor.getLastFunctionNumber();
+        bool agree = true;
+
+        for (uint64_t f = 0; agree && f <= last; f++)
+        {
+            std::vector<int> order(n);
+            std::vector<uint64_t> orbit;
+
+            for (int i = 0; i < n; i++)
+                order[i] = i;
+
+            do
+                orbit.push_back(permuteVariables(f, order));
+            while (std::next_permutation(order.begin(), order.end()));
+
+            std::sort(orbit.begin(), orbit.end());
+            orbit.erase(std::unique(orbit.begin(), orbit.end()), orbit.end());
+
+            uint64_t orbitSize = 0;
+
+            agree = executor.canonicalize(f, &orbitSize) == orbit[0] && orbitSize == orbit.size();
+        }
+
+        report(agree, "canonical n=" + std::to_string(n) + ": least relabeling and orbit size of every function");
+    }
+
+    for (int n = 0; n <= std::min(maxN, MAX_PACKED_SIZE); n++)
+    {
+        executor.changeVectorSpaceSize(n);
+
+        bignum_t canonicalCount = 0, orbitTotal = 0;
+        bool agree = true;
+
+        executor.enumerateCanonicalMonotone(0, executor.getLastFunctionNumber(), [&](uint64_t f, uint64_t orbitSize) {
+            uint64_t size = 0;
+
+            agree = agree && executor.canonicalize(f, &size) == f && size == orbitSize;
+            canonicalCount++;
+            orbitTotal += orbitSize;
+        });
+
+        report(agree && canonicalCount == INEQUIVALENT_MONOTONE_COUNTS[n] && orbitTotal == DEDEKIND_NUMBERS[n],
+               "canonical n=" + std::to_string(n) + ": " + std::to_string((uint64_t)canonicalCount) +
+                   " classes covering the Dedekind number");
+    }
+
+    if (maxN < MAX_PACKED_SIZE)
+        return;
+
+    uint64_t state = 2463534242ULL;
+    bool agree = true;
+
+    for (int i = 0; agree && i < 1000; i++)
+    {
+        nextRandom(state);
+
+        std::vector<int> order = {0, 1, 2, 3, 4, 5};
+
+        for (int j = 5; j > 0; j--)
+            std::swap(order[j], order[(state >> (j * 3)) % (j + 1)]);
+
+        uint64_t f = state * 0x9E3779B97F4A7C15ULL, size = 0, permutedSize = 0;
+
+        agree = executor.canonicalize(f, &size) == executor.canonicalize(permuteVariables(f, order), &permutedSize) &&
+                size == permutedSize;
+    }
+
+    report(agree, "canonical n=6: invariant under random relabelings");
+}
+
+// statistics: brute force over the alpha order for small n, the same counts
+// from one and several threads, the n=5 chunks of 5.csv, n=6 totals
+void checkStatistics(Executor &executor, int maxN, const std::vector<bignum_t> &chunkCounts)
+{
+    for (int n = 0; n <= std::min(maxN, 4); n++)
+    {
+        forEachAlpha(n, [&](std::vector<int> alpha, bool mixed) {
+            executor.changeVectorSpaceSize(n, alpha.data());
+
+            int points = 1 << n;
+            std::vector<uint64_t> weight(points + 1), terms(points + 1), degree(n + 1);
+
+            // input x_i of position p is bit n - 1 - i of ~p
+            auto below = [&](int q, int p) {
+                for (int i = 0; i < n; i++)
+                {
+                    int xq = (~q >> (n - 1 - i)) & 1, xp = (~p >> (n - 1 - i)) & 1;
+
+                    if (alpha[i] ? xq > xp : xq < xp)
+                        return false;
+                }
+
+                return true;
+            };
+
+            executor.enumerateMonotone(0, executor.getLastFunctionNumber(), [&](widenum_t f) {
+                int count = 0, longest = 0;
+
+                for (int p = 0; p < points; p++)
+                {
+                    bool minimal = (f >> p) & 1;
+
+                    for (int q = 0; minimal && q < points; q++)
+                        minimal = q == p || !((f >> q) & 1) || !below(q, p);
+
+                    if (!minimal)
+                        continue;
+
+                    int size = 0;
+
+                    for (int i = 0; i < n; i++)
+                        size += ((~p >> (n - 1 - i)) & 1) == alpha[i];
+
+                    count++;
+                    longest = std::max(longest, size);
+                }
+
+                weight[__builtin_popcountll((uint64_t)f)]++;
+                terms[count]++;
+                degree[longest]++;
+            });
+
+            MonotoneStatistics single = executor.collectStatistics(0, executor.getLastFunctionNumber(), 16, 1);
+            MonotoneStatistics several = executor.collectStatistics(0, executor.getLastFunctionNumber(), 16, 3);
+
+            terms.resize(single.byMinimalTerms.size());
+
+            bool agree = single.total == DEDEKIND_NUMBERS[n] && single.byWeight == weight && single.byMinimalTerms == terms &&
+                         single.byDegree == degree && several.byWeight == weight && several.byMinimalTerms == terms &&
+                         several.byDegree == degree && several.byChunk == single.byChunk;
+
+            report(agree, "statistics n=" + std::to_string(n) + (mixed ? " alpha 0101..." : "") + ": histograms match brute force");
+        });
+    }
+
+    if (maxN >= 5 && chunkCounts.size() == 256)
+    {
+        executor.changeVectorSpaceSize(5);
+
+        MonotoneStatistics statistics = executor.collectStatistics(0, executor.getLastFunctionNumber(), 256, 4);
+
+        report(std::equal(chunkCounts.begin(), chunkCounts.end(), statistics.byChunk.begin()) &&
+                   statistics.chunkSize == CHUNK_SIZE_5,
+               "statistics n=5: chunks match 5.csv");
+    }
+
+    if (maxN < MAX_PACKED_SIZE)
+        return;
+
+    executor.changeVectorSpaceSize(MAX_PACKED_SIZE);
+
+    MonotoneStatistics statistics = executor.collectStatistics(0, executor.getLastFunctionNumber());
+    bignum_t weights = 0, terms = 0, degrees = 0, chunks = 0;
+    bool symmetric = true;
+
+    for (std::size_t i = 0; i < statistics.byWeight.size(); i++)
+    {
+        weights += statistics.byWeight[i];
+        symmetric = symmetric && statistics.byWeight[i] == statistics.byWeight[statistics.byWeight.size() - 1 - i];
+    }
+
+    for (auto count : statistics.byMinimalTerms)
+        terms += count;
+
+    for (auto count : statistics.byDegree)
+        degrees += count;
+
+    for (auto count : statistics.byChunk)
+        chunks += count;
+
+    report(statistics.total == DEDEKIND_NUMBERS[MAX_PACKED_SIZE] && weights == statistics.total && terms == statistics.total &&
+               degrees == statistics.total && chunks == statistics.total && symmetric,
+           "statistics n=6: every histogram sums to the Dedekind number, weights are self-dual");
+}
+
+// every dispatch tier this CPU has against the generic routines: batches,
+// ranges with ragged ends, multiword tables and statistics
+void checkDispatch(Executor &executor, int maxN)
+{
+    uint64_t state = 88172645463325252ULL;
+
+    std::cout << "dispatch: " << toString(getCpuLevel()) << " is the best tier of this CPU" << std::endl;
+
+    std::vector<uint64_t> numbers(1003);
+
+    for (std::size_t i = 0; i < numbers.size(); i++)
+        numbers[i] = i % 2 ? nextRandomMonotone(state, 6) : nextRandom(state);
+
+    // threshold functions of 10 variables, x >= k ones, and copies with one bit flipped
+    const int wideN = 10;
+    std::vector<TruthTable> tables;
+
+    for (int k = 0; k <= wideN + 1; k++)
+    {
+        TruthTable table(wideN);
+
+        for (int p = 0; p < (1 << wideN); p++)
+        {
+            if (wideN - __builtin_popcount(p) >= k)
+                table.words()[p / 64] |= 1ULL << (p % 64);
+        }
+
+        tables.push_back(table);
+        table.words()[nextRandom(state) % table.wordCount()] ^= 1ULL << (nextRandom(state) % 64);
+        tables.push_back(table);
+    }
+
+    for (int level = (int)CpuLevel::Generic; level <= (int)getCpuLevel(); level++)
+    {
+        bool agree = true;
+
+        for (int n = std::min(maxN, 5); agree && n <= std::min(maxN, MAX_PACKED_SIZE); n++)
+        {
+            forEachAlpha(n, [&](std::vector<int> alpha, bool) {
+                if (!agree)
+                    return;
+
+                executor.changeVectorSpaceSize(n, alpha.data());
+                executor.setCpuLevel(CpuLevel::Generic);
+
+                MonotoneStatistics expected = executor.collectStatistics(0, executor.getLastFunctionNumber(), 16, 1);
+                std::vector<uint64_t> batch(16), range(16);
+                uint64_t first = n == MAX_PACKED_SIZE ? nextRandomMonotone(state, 6) - 500 : 0;
+
+                executor.setCpuLevel((CpuLevel)level);
+                executor.calculateMonotonicityBatch(numbers.data(), numbers.size(), batch.data());
+                executor.calculateMonotonicityRange(first, numbers.size(), range.data());
+
+                for (std::size_t i = 0; agree && i < numbers.size(); i++)
+                {
+                    agree = ((batch[i / 64] >> (i % 64)) & 1) == executor.checkMonotonicity(numbers[i], Engine::Packed) &&
+                            ((range[i / 64] >> (i % 64)) & 1) == executor.checkMonotonicity(first + i, Engine::Packed);
+                }
+
+                MonotoneStatistics statistics = executor.collectStatistics(0, executor.getLastFunctionNumber(), 16, 1);
+
+                agree = agree && batch[numbers.size() / 64] >> (numbers.size() % 64) == 0 &&
+                        range[numbers.size() / 64] >> (numbers.size() % 64) == 0 && statistics.byWeight == expected.byWeight &&
+                        statistics.byMinimalTerms == expected.byMinimalTerms && statistics.byDegree == expected.byDegree;
+            });
+        }
+
+        executor.changeVectorSpaceSize(wideN);
+
+        for (std::size_t i = 0; agree && i < tables.size(); i++)
+        {
+            executor.setCpuLevel(CpuLevel::Generic);
+
+            bool expected = executor.calculateMonotonicity(tables[i]);
+
+            executor.setCpuLevel((CpuLevel)level);
+
+            agree = executor.calculateMonotonicity(tables[i]) == expected && (i % 2 || expected);
+        }
+
+        report(agree && executor.getCpuLevel() == (CpuLevel)level,
+               std::string("dispatch ") + toString((CpuLevel)level) + ": agrees with the generic routines");
+    }
+
+    executor.setCpuLevel(getCpuLevel());
+}
+
+// results files: write, read back whole and from a seek, reject corruption
+void checkResults(Executor &executor, int maxN)
+{
+    char directory[] = "/tmp/qmftest-results-XXXXXX";
+
+    if (!mkdtemp(directory))
+    {
+        report(false, "results: scratch directory");
+        return;
+    }
+
+    std::string path = std::string(directory) + "/monotone.qmr";
+    int n = std::min(maxN, 5);
+    std::vector<int> alpha = mixedAlpha(n);
+
+    executor.changeVectorSpaceSize(n, alpha.data());
+
+    std::vector<widenum_t> monotone;
+    executor.enumerateMonotone(0, executor.getLastFunctionNumber(), [&](widenum_t f) { monotone.push_back(f); });
+
+    // 128-bit gaps between the block boundaries
+    monotone.push_back((widenum_t)1 << 100);
+    monotone.push_back(~(widenum_t)0);
+
+    ResultWriter writer;
+    bool written = writer.open(path, n, alpha);
+
+    for (auto f : monotone)
+        written = written && writer.addFunction(f);
+
+    written = written && !writer.addFunction(monotone.back()) && writer.isOpen();
+    writer.close();
+
+    written = writer.open(path, n, alpha);
+
+    for (auto f : monotone)
+        written = written && writer.addFunction(f);
+
+    written = written && writer.addChunk(0, 1 << 20, 7) && writer.addChunk(1 << 20, ~(widenum_t)0, 9);
+    writer.setMetadata("program", "qmftest");
+    writer.setMetadata("program", "qmftest results");
+    written = written && writer.close();
+
+    report(written, "results: written, a decreasing number is refused");
+
+    ResultReader reader;
+    std::vector<widenum_t> read, tail;
+    bool agree = reader.open(path) && reader.size() == n && reader.alpha() == alpha && reader.count() == monotone.size() &&
+                 reader.readFunctions(0, ~(widenum_t)0, [&](widenum_t f) { read.push_back(f); }) && read == monotone;
+
+    std::size_t middle = monotone.size() / 2;
+    agree = agree && reader.readFunctions(monotone[middle] + 1, monotone[middle + 2], [&](widenum_t f) { tail.push_back(f); }) &&
+            tail == std::vector<widenum_t>{monotone[middle + 1], monotone[middle + 2]};
+
+    agree = agree && reader.chunks().size() == 2 && reader.chunks()[1].end == ~(widenum_t)0 && reader.chunks()[1].count == 9 &&
+            reader.metadata().size() == 1 && reader.metadata()[0].second == "qmftest results" && reader.verify();
+
+    report(agree, "results n=" + std::to_string(n) + ": functions, seek, chunks and metadata read back");
+
+    reader.close();
+
+    // one flipped bit in the first function block
+    FILE *file = fopen(path.c_str(), "r+b");
+    bool corrupted = false;
+
+    if (file && fseek(file, 48, SEEK_SET) == 0)
+    {
+        int byte = fgetc(file);
+
+        corrupted = fseek(file, 48, SEEK_SET) == 0 && fputc(byte ^ 1, file) != EOF;
+    }
+
+    if (file)
+        fclose(file);
+
+    report(corrupted && reader.open(path) && !reader.verify() && !reader.readFunctions(0, ~(widenum_t)0, [](widenum_t) {}),
+           "results: a corrupt block fails its checksum");
+
+    reader.close();
+    std::remove(path.c_str());
+    rmdir(directory);
+}
+
+std::map<std::string, double> loadBaseline(const std::string &path)
+{
+    std::map<std::string, double> baseline;
+    std::ifstream file(path);
+    std::string line;
+
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::stringstream ss(line);
+        std::string engine, n, rate;
+
+        std::getline(ss, engine, ',');
+        std::getline(ss, n, ',');
+        std::getline(ss, rate, ',');
+
+        if (!rate.empty())
+            baseline[engine + "," + n] = std::stod(rate);
+    }
+
+    return baseline;
+}
+
+void saveBaseline(const std::string &path, const std::map<std::string, double> &baseline)
+{
+    std::ofstream file(path);
+
+    file << "# engine,n,functions per second (qmftest --update-baseline)\n";
+
+    for (auto &entry : baseline)
+    {
+        file << entry.first << "," << (bignum_t)entry.second << "\n";
+    }
+}
+
+// precomputation cache: an executor switching between more configurations
+// than it keeps answers like fresh ones, and ranking tables written to disk
+// are read back, or rebuilt when damaged
+void checkCache(int maxN)
+{
+    int n = std::min(maxN, 4);
+    std::vector<std::vector<int>> alphas = {std::vector<int>(n, 1), std::vector<int>(n, 0), mixedAlpha(n)};
+
+    Executor cached(false);
+    bool agree = true;
+
+    cached.setCacheCapacity(2);
+
+    // with room for two, the third configuration always evicts one
+    for (int index : {0, 1, 2, 0, 2, 1, 0})
+    {
+        std::vector<int> &alpha = alphas[index];
+        Executor fresh(false);
+
+        cached.changeVectorSpaceSize(n, alpha.data());
+        fresh.changeVectorSpaceSize(n, alpha.data());
+
+        for (uint64_t f = 0; agree && f <= (uint64_t)fresh.getLastFunctionNumber(); f++)
+        {
+            uint64_t cachedOrbit = 0, freshOrbit = 0;
+
+            agree = cached.checkMonotonicity(f, Engine::Table) == fresh.checkMonotonicity(f, Engine::Table) &&
+                    cached.checkMonotonicity(f, Engine::Transform) == fresh.checkMonotonicity(f, Engine::Transform) &&
+                    cached.canonicalize(f, &cachedOrbit) == fresh.canonicalize(f, &freshOrbit) && cachedOrbit == freshOrbit &&
+                    cached.countInterval(f & 0x0F0F, f | 0x0F0F) == fresh.countInterval(f & 0x0F0F, f | 0x0F0F);
+        }
+    }
+
+    report(agree, "cache n=" + std::to_string(n) + ": switching alpha past the capacity answers like a fresh executor");
+
+    // @3, @3 0 1 0, @3 as the REPL runs them: Kf and Kf_inverse are printed
+    // again when the configuration comes back from the cache
+    {
+        int small = std::min(maxN, 3);
+        std::vector<int> alpha = mixedAlpha(small);
+        std::vector<std::string> printed;
+        std::stringstream captured;
+        std::streambuf *saved = std::cout.rdbuf(captured.rdbuf());
+
+        Executor verbose(true);
+
+        for (int pass = 0; pass < 2; pass++)
+        {
+            for (int *configuration : {(int *)nullptr, alpha.data()})
+            {
+                captured.str("");
+                verbose.changeVectorSpaceSize(small, configuration);
+                printed.push_back(captured.str());
+            }
+        }
+
+        std::cout.rdbuf(saved);
+
+        report(printed[0] == printed[2] && printed[1] == printed[3] && printed[0].find("Kf_inverse:") != std::string::npos,
+               "cache n=" + std::to_string(small) + ": a cached configuration prints its operators as a new one does");
+    }
+
+    char directory[] = "/tmp/qmftest-cache-XXXXXX";
+
+    if (!mkdtemp(directory))
+    {
+        report(false, "cache: scratch directory");
+        return;
+    }
+
+    // operators, answer table and permutation network read back from the
+    // directory answer like built ones; a damaged file is rebuilt
+    agree = true;
+
+    for (int pass = 0; pass < 3; pass++)
+    {
+        for (auto &alpha : alphas)
+        {
+            Executor executor(false), fresh(false);
+
+            executor.setCacheDirectory(directory);
+            executor.changeVectorSpaceSize(n, alpha.data());
+            fresh.changeVectorSpaceSize(n, alpha.data());
+
+            for (uint64_t f = 0; agree && f <= (uint64_t)fresh.getLastFunctionNumber(); f += 7)
+            {
+                uint64_t cachedOrbit = 0, freshOrbit = 0;
+
+                agree = executor.checkMonotonicity(f, Engine::Table) == fresh.checkMonotonicity(f, Engine::Table) &&
+                        executor.checkMonotonicity(f, Engine::Transform) == fresh.checkMonotonicity(f, Engine::Transform) &&
+                        executor.canonicalize(f, &cachedOrbit) == fresh.canonicalize(f, &freshOrbit) && cachedOrbit == freshOrbit;
+            }
+
+            std::string path = std::string(directory) + "/tables-" + std::to_string(n) + "-";
+
+            for (int a : alpha)
+                path += a ? '1' : '0';
+
+            path += ".qmc";
+            agree = agree && access(path.c_str(), R_OK) == 0;
+
+            if (pass == 1)
+                truncate(path.c_str(), 100);
+
+            if (pass == 2)
+                std::remove(path.c_str());
+        }
+    }
+
+    report(agree, "cache n=" + std::to_string(n) + ": operators and tables are written, read back and rebuilt when damaged");
+
+    n = std::min(maxN, MAX_PACKED_SIZE);
+
+    std::vector<uint64_t> counts;
+
+    for (int pass = 0; pass < 3; pass++)
+    {
+        Executor executor(false);
+        widenum_t f = 0;
+        uint64_t k = 0;
+
+        executor.setCacheDirectory(directory);
+        executor.changeVectorSpaceSize(n);
+
+        uint64_t count = executor.getMonotoneCount();
+
+        counts.push_back(executor.unrankMonotone(count / 3, f) && executor.rankMonotone(f, k) && k == count / 3 ? count : 0);
+
+        // a truncated level is rebuilt, not read
+        if (pass == 1 && n > 0)
+        {
+            std::string path = std::string(directory) + "/ranking-" + std::to_string(n - 1) + ".qmc";
+
+            truncate(path.c_str(), 40);
+        }
+    }
+
+    report(counts[0] == DEDEKIND_NUMBERS[n] && counts[1] == counts[0] && counts[2] == counts[0],
+           "cache n=" + std::to_string(n) + ": ranking tables are written, read back and rebuilt when damaged");
+
+    for (int level = 0; level < n; level++)
+        std::remove((std::string(directory) + "/ranking-" + std::to_string(level) + ".qmc").c_str());
+
+    rmdir(directory);
+}
+
+// runs script through runBatch with stdout and stderr sent to scratch files,
+// returns its status and what it printed to stdout
+int runScript(Executor &executor, const std::string &directory, const std::string &script, std::string &output)
+{
+    std::string scriptPath = directory + "/script.txt";
+    std::string outputPath = directory + "/output.txt";
+    std::string errorPath = directory + "/errors.txt";
+
+    std::ofstream(scriptPath, std::ios::binary) << script;
+
+    std::cout.flush();
+    fflush(stdout);
+    fflush(stderr);
+
+    int savedOutput = dup(1);
+    int savedError = dup(2);
+    int outputFile = open(outputPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    int errorFile = open(errorPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    dup2(outputFile, 1);
+    dup2(errorFile, 2);
+    close(outputFile);
+    close(errorFile);
+
+    int status = runBatch(&executor, scriptPath.c_str());
+
+    fflush(stdout);
+    fflush(stderr);
+    dup2(savedOutput, 1);
+    dup2(savedError, 2);
+    close(savedOutput);
+    close(savedError);
+
+    std::ifstream file(outputPath, std::ios::binary);
+    std::stringstream text;
+    text << file.rdbuf();
+    output = text.str();
+
+    std::remove(scriptPath.c_str());
+    std::remove(outputPath.c_str());
+    std::remove(errorPath.c_str());
+
+    return status;
+}
+
+// batch scripts answer as the executor does when called directly: numbers
+// across a query window and an alpha change, $, ?f and [f g]; a malformed
+// line stops the script with status 1 after the answers before it
+void checkBatchScripts(Executor &executor, int maxN)
+{
+    char directory[] = "/tmp/qmftest-batch-XXXXXX";
+
+    if (!mkdtemp(directory))
+    {
+        report(false, "batch script: scratch directory");
+        return;
+    }
+
+    int n = std::min(maxN, 5);
+    std::string configuration = "@" + std::to_string(n);
+    std::vector<int> alpha = mixedAlpha(n);
+
+    for (int a : alpha)
+        configuration += " " + std::to_string(a);
+
+    executor.changeVectorSpaceSize(n);
+
+    std::vector<uint64_t> monotone;
+    executor.enumerateMonotone(0, executor.getLastFunctionNumber(), [&](widenum_t f) { monotone.push_back((uint64_t)f); });
+
+    uint64_t state = 2463534242ULL;
+
+    // a third monotone under alpha = 1, the rest mostly not; the alpha
+    // change comes after the first window has been answered
+    std::size_t count = QUERY_WINDOW + 1000;
+    std::size_t switchAt = QUERY_WINDOW + 500;
+    std::string script = "@" + std::to_string(n) + "\n";
+    std::string expected;
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        uint64_t f = i % 3 ? nextRandom(state) & executor.getLastFunctionNumber() : monotone[nextRandom(state) % monotone.size()];
+
+        if (i == switchAt)
+        {
+            script += configuration + "\n";
+            executor.changeVectorSpaceSize(n, alpha.data());
+        }
+
+        script += std::to_string(f) + "\n";
+        expected += executor.checkMonotonicity(f, Engine::Packed) ? "Yes\n" : "No\n";
+    }
+
+    std::string output;
+    int status = runScript(executor, directory, script, output);
+
+    report(status == 0 && output == expected,
+           "batch script n=" + std::to_string(n) + ": " + std::to_string(count) + " numbers across a query window and an alpha change");
+
+    // $, ?f and [f g] under the mixed alpha of n = 3
+    int small = std::min(maxN, 3);
+
+    executor.changeVectorSpaceSize(small, alpha.data());
+
+    script = "@" + std::to_string(small);
+    expected.clear();
+    monotone.clear();
+
+    for (int i = 0; i < small; i++)
+        script += " " + std::to_string(alpha[i]);
+
+    script += "\n$\n";
+
+    executor.enumerateMonotone(0, executor.getLastFunctionNumber(), [&](widenum_t f) {
+        monotone.push_back((uint64_t)f);
+        expected += toString(f) + "\n";
+    });
+
+    expected += "Monotonic functions count for given vector space: " + std::to_string(monotone.size()) + "\n";
+
+    for (uint64_t f = 0; f <= executor.getLastFunctionNumber(); f += 37)
+    {
+        script += "?" + std::to_string(f) + "\n";
+        expected += toString(executor.calculateUnateness(f), small) + "\n";
+    }
+
+    uint64_t lower = monotone[monotone.size() / 3];
+    uint64_t upper = executor.getLastFunctionNumber();
+
+    script += "[" + std::to_string(lower) + " " + std::to_string(upper) + "]\n";
+    expected += "Monotone functions in the interval: " + std::to_string(executor.countInterval(lower, upper)) + "\n";
+
+    status = runScript(executor, directory, script, output);
+
+    report(status == 0 && output == expected,
+           "batch script n=" + std::to_string(small) + " alpha 0101...: $, ?f and [f g] answer as the executor");
+
+    // the number before the malformed line is answered, the one after is not;
+    // listing n = 7 would step through 2^128 numbers, so it is refused too
+    bool rejected = true;
+
+    for (const char *line : {"12abc", "@99", "@3 1 0", "[1]", "?xyz", "=0x1g", "@7\n$", "@7\n$>/dev/null"})
+    {
+        status = runScript(executor, directory, "@3\n0\n" + std::string(line) + "\n255\n", output);
+        rejected = rejected && status == 1 && output == "Yes\n";
+    }
+
+    report(rejected, "batch script: malformed and refused lines stop the script with status 1");
+
+    rmdir(directory);
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--data" && i + 1 < argc)
+            options.dataDir = argv[++i];
+        else if (arg == "--engine" && i + 1 < argc)
+            options.engine = argv[++i];
+        else if (arg == "--max-n" && i + 1 < argc)
+            options.maxN = std::min(std::atoi(argv[++i]), MAX_N);
+        else if (arg == "--tolerance" && i + 1 < argc)
+            options.tolerance = std::atof(argv[++i]);
+        else if (arg == "--update-baseline")
+            options.updateBaseline = true;
+        else
+        {
+            std::cout << "usage: qmftest [--data dir] [--engine name] [--max-n n] [--tolerance t] [--update-baseline]" << std::endl;
+            return 2;
+        }
+    }
+
+    std::string baselinePath = options.dataDir + "/qmftest_baseline.csv";
+
+    std::vector<bignum_t> chunkCounts, loggedChunkCounts, selfDualList;
+
+    bool haveChunks = loadChunkCsv(options.dataDir + "/5.csv", chunkCounts);
+    bool haveLog = loadChunkLog(options.dataDir + "/solution_5.txt", loggedChunkCounts);
+    bool haveSelfDual = loadSelfDualList(options.dataDir + "/hist.csv", selfDualList);
+
+    report(haveChunks && chunkCounts.size() == 256, "5.csv has 256 chunks");
+    report(haveLog && loggedChunkCounts == chunkCounts, "solution_5.txt matches 5.csv");
+    report(haveSelfDual && selfDualList.size() == SELF_DUAL_MONOTONE_COUNTS[5], "hist.csv lists every self-dual n=5 function");
+
+    bignum_t recordedTotal = 0;
+
+    for (auto count : chunkCounts)
+        recordedTotal += count;
+
+    report(recordedTotal == DEDEKIND_NUMBERS[5], "5.csv chunks sum to the Dedekind number");
+
+    auto baseline = loadBaseline(baselinePath);
+    // per n, the same blocks for every engine that samples it
+    std::map<int, std::vector<uint64_t>> blocks;
+    std::map<int, std::pair<bignum_t, bignum_t>> sampledCounts;
+    auto measured = baseline;
+
+    Executor executor(false);
+
+    checkMultiword(executor);
+    checkOrientations(executor, options.maxN);
+    checkGenerated(options.maxN);
+    checkEnumeration(executor, options.maxN);
+    checkStore(executor, options.maxN);
+    checkRanking(executor, options.maxN);
+    checkInterval(executor, options.maxN);
+    checkCanonical(executor, options.maxN);
+    checkStatistics(executor, options.maxN, chunkCounts);
+    checkDispatch(executor, options.maxN);
+    checkCache(options.maxN);
+    checkResults(executor, options.maxN);
+    checkBatchScripts(executor, options.maxN);
+
+    for (auto &engine : ENGINES)
+    {
+        if (!options.engine.empty() && options.engine != engine.name)
+            continue;
+
+        for (int n = 0; n <= options.maxN; n++)
+        {
+            std::string tag = std::string(engine.name) + " n=" + std::to_string(n);
+
+            if (n > engine.maxSampledN)
+            {
+                skip(tag + ": too large for this engine");
+                continue;
+            }
+
+            executor.changeVectorSpaceSize(n);
+
+            bool sampled = n > engine.maxN;
+            bignum_t expectedMonotone = DEDEKIND_NUMBERS[n], expectedSelfDual = SELF_DUAL_MONOTONE_COUNTS[n];
+
+            if (sampled)
+            {
+                tag += " sampled";
+
+                if (!blocks.count(n))
+                {
+                    blocks[n] = sampleBlocks(executor);
+                    countSampled(executor, n, blocks[n], sampledCounts[n].first, sampledCounts[n].second);
+                }
+
+                expectedMonotone = sampledCounts[n].first;
+                expectedSelfDual = sampledCounts[n].second;
+            }
+
+            SweepResult r = sampled ? sampledSweep(engine, executor, n, blocks[n]) : sweep(engine, executor, n);
+
+            report(r.monotoneCount == expectedMonotone,
+                   tag + ": " + std::to_string(r.monotoneCount) + " monotone, expected " + std::to_string(expectedMonotone));
+            report(r.selfDualCount == expectedSelfDual,
+                   tag + ": " + std::to_string(r.selfDualCount) + " self-dual, expected " + std::to_string(expectedSelfDual));
+
+            if (n == 5 && !sampled)
+            {
+                report(r.chunkCounts == chunkCounts, tag + ": per-chunk counts match 5.csv");
+                report(r.selfDualFunctions == selfDualList, tag + ": self-dual functions match hist.csv");
+            }
+
+            if (!sampled && executor.getTotalFunctionsCount() < MIN_TIMED_SWEEP)
+                continue;
+
+            std::string key = std::string(engine.name) + "," + std::to_string(n);
+            std::string rate = std::to_string((bignum_t)r.functionsPerSecond) + " functions/s";
+
+            measured[key] = r.functionsPerSecond;
+
+            if (options.updateBaseline)
+            {
+                std::cout << "[ BASE ] " << tag << ": " << rate << std::endl;
+            }
+            else if (baseline.count(key))
+            {
+                double floor = baseline[key] * (1 - options.tolerance);
+
+                report(r.functionsPerSecond >= floor,
+                       tag + ": " + rate + ", baseline " + std::to_string((bignum_t)baseline[key]));
+            }
+            else
+            {
+                skip(tag + ": " + rate + ", no baseline recorded");
+            }
+        }
+    }
+
+    if (options.updateBaseline)
+        saveBaseline(baselinePath, measured);
+
+    std::cout << (failures ? "FAILED: " : "PASSED") << (failures ? std::to_string(failures) + " check(s)" : "") << std::endl;
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,302 @@
+#include <ranking.hpp>
+
+#include <cofactors.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+static bool isMonotone(uint64_t functionNumber, int size)
+{
+    for (int j = 0; j < size; j++)
+    {
+        if ((functionNumber >> (1 << j)) & ~functionNumber & VARIABLE_MASKS[j])
+            return false;
+    }
+
+    return true;
+}
+
+static const char LEVEL_MAGIC[8] = {'Q', 'M', 'F', 'R', 'A', 'N', 'K', ' '};
+static const uint32_t LEVEL_VERSION = 1;
+
+// native byte order, like the stores
+struct LevelHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t size;
+    uint64_t functionCount;
+    uint64_t prefixCount;
+};
+
+void MonotoneRanking::prepare(int size)
+{
+    for (int n = mLevels.size(); n < std::min(size, MAX_RANKING_SIZE); n++)
+    {
+        if (!mDirectory.empty() && loadLevel(n))
+            continue;
+
+        buildLevel(n);
+
+        if (!mDirectory.empty())
+            saveLevel(n);
+    }
+}
+
+std::string MonotoneRanking::getLevelPath(int size) const
+{
+    return mDirectory + "/ranking-" + std::to_string(size) + ".qmc";
+}
+
+bool MonotoneRanking::loadLevel(int size)
+{
+    FILE *file = fopen(getLevelPath(size).c_str(), "rb");
+
+    if (!file)
+        return false;
+
+    LevelHeader header;
+    Level level;
+
+    bool read = fread(&header, sizeof(header), 1, file) == 1 && std::memcmp(header.magic, LEVEL_MAGIC, sizeof(header.magic)) == 0 &&
+                header.version == LEVEL_VERSION && header.size == (uint32_t)size && header.prefixCount >= 2 &&
+                header.prefixCount <= (1ULL << 24) && header.functionCount <= header.prefixCount;
+
+    if (read)
+    {
+        level.functions.resize(header.functionCount);
+        level.prefix.resize(header.prefixCount);
+
+        read = fread(level.functions.data(), sizeof(uint64_t), level.functions.size(), file) == level.functions.size() &&
+               fread(level.prefix.data(), sizeof(uint64_t), level.prefix.size(), file) == level.prefix.size() &&
+               fgetc(file) == EOF;
+    }
+
+    fclose(file);
+
+    // the level below tells how many functions this one has
+    bool listed = size == MAX_RANKING_SIZE - 1 ? level.functions.empty() : level.functions.size() + 1 == level.prefix.size();
+
+    if (!read || !listed || (size > 0 && level.prefix.size() != mLevels[size - 1].prefix.back() + 1) ||
+        !std::is_sorted(level.prefix.begin(), level.prefix.end()) || !std::is_sorted(level.functions.begin(), level.functions.end()))
+        return false;
+
+    mLevels.push_back(std::move(level));
+    return true;
+}
+
+bool MonotoneRanking::saveLevel(int size) const
+{
+    const Level &level = mLevels[size];
+    LevelHeader header;
+
+    std::memcpy(header.magic, LEVEL_MAGIC, sizeof(header.magic));
+    header.version = LEVEL_VERSION;
+    header.size = size;
+    header.functionCount = level.functions.size();
+    header.prefixCount = level.prefix.size();
+
+    // written aside and renamed, as the stores are
+    std::string path = getLevelPath(size), temporaryPath = path + ".tmp";
+    FILE *file = fopen(temporaryPath.c_str(), "wb");
+
+    if (!file)
+        return false;
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(level.functions.data(), sizeof(uint64_t), level.functions.size(), file) == level.functions.size() &&
+                   fwrite(level.prefix.data(), sizeof(uint64_t), level.prefix.size(), file) == level.prefix.size();
+
+    written = fclose(file) == 0 && written;
+
+    if (!written || std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+void MonotoneRanking::buildLevel(int size)
+{
+    Level level;
+
+    if (size == 0)
+    {
+        // both constants, 0 lies below both of them
+        level.functions = {0, 1};
+        level.prefix = {0, 2, 3};
+        mLevels.push_back(level);
+        return;
+    }
+
+    const Level &previous = mLevels[size - 1];
+    const std::vector<uint64_t> &functions = previous.functions;
+    std::size_t count = functions.size();
+    int half = 1 << (size - 1);
+
+    std::vector<uint64_t> above(count);
+
+    for (std::size_t i = 0; i < count; i++)
+        above[i] = previous.prefix[i + 1] - previous.prefix[i];
+
+    // position of f_i | f_j, 7581^2 entries of 16 bits at n = 5
+    std::vector<uint16_t> join(count * count);
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        for (std::size_t j = 0; j < count; j++)
+        {
+            join[i * count + j] = std::lower_bound(functions.begin(), functions.end(), functions[i] | functions[j]) -
+                                  functions.begin();
+        }
+    }
+
+    level.prefix.push_back(0);
+
+    if (size < MAX_RANKING_SIZE - 1)
+        level.functions.reserve(previous.prefix.back());
+
+    std::vector<uint16_t> upper;
+
+    // f0:f1 in increasing order; the functions above it are the c0:c1 with
+    // c0 above f0 and c1 above c0 | f1, and f1 is one of the c0
+    for (std::size_t f0 = 0; f0 < count; f0++)
+    {
+        upper.clear();
+
+        for (std::size_t c = f0; c < count; c++)
+        {
+            if ((functions[f0] & ~functions[c]) == 0)
+                upper.push_back(c);
+        }
+
+        for (uint16_t f1 : upper)
+        {
+            const uint16_t *row = &join[f1 * count];
+            uint64_t completions = 0;
+
+            for (uint16_t c : upper)
+                completions += above[row[c]];
+
+            level.prefix.push_back(level.prefix.back() + completions);
+
+            if (size < MAX_RANKING_SIZE - 1)
+                level.functions.push_back(functions[f0] << half | functions[f1]);
+        }
+    }
+
+    mLevels.push_back(level);
+}
+
+uint64_t MonotoneRanking::count(int size) const
+{
+    return size == 0 ? 2 : mLevels[size - 1].prefix.back();
+}
+
+uint64_t MonotoneRanking::countAbove(int size, uint64_t lower) const
+{
+    const Level &level = mLevels[size];
+    std::size_t i = std::lower_bound(level.functions.begin(), level.functions.end(), lower) - level.functions.begin();
+
+    return level.prefix[i + 1] - level.prefix[i];
+}
+
+uint64_t MonotoneRanking::countBelow(int size, uint64_t lower, uint64_t bound) const
+{
+    if (size == 0)
+        return lower == 0 && bound != 0;
+
+    int half = 1 << (size - 1);
+    uint64_t lowMask = (1ULL << half) - 1;
+    uint64_t lower0 = lower >> half, lower1 = lower & lowMask;
+    uint64_t bound0 = bound >> half, bound1 = bound & lowMask;
+    const Level &previous = mLevels[size - 1];
+    uint64_t below = 0;
+
+    // smaller high cofactors, each with all of its completions
+    if (lower == 0)
+    {
+        below = previous.prefix[countBelow(size - 1, 0, bound0)];
+    }
+    else
+    {
+        for (uint64_t c : previous.functions)
+        {
+            if (c >= bound0)
+                break;
+
+            if ((lower0 & ~c) == 0)
+                below += countAbove(size - 1, c | lower1);
+        }
+    }
+
+    // the high cofactor of the bound itself, with smaller low cofactors
+    if ((lower0 & ~bound0) == 0 && isMonotone(bound0, size - 1))
+        below += countBelow(size - 1, lower1 | bound0, bound1);
+
+    return below;
+}
+
+uint64_t MonotoneRanking::rank(int size, widenum_t functionNumber) const
+{
+    if (size < MAX_RANKING_SIZE)
+        return countBelow(size, 0, (uint64_t)functionNumber);
+
+    // countBelow one level up, the n = 6 functions are not listed
+    uint64_t high = (uint64_t)(functionNumber >> 64), low = (uint64_t)functionNumber;
+    uint64_t below = mLevels[size - 1].prefix[countBelow(size - 1, 0, high)];
+
+    if (isMonotone(high, size - 1))
+        below += countBelow(size - 1, high, low);
+
+    return below;
+}
+
+uint64_t MonotoneRanking::select(int size, uint64_t lower, uint64_t k) const
+{
+    if (size == 0)
+        return lower == 0 ? k : 1;
+
+    int half = 1 << (size - 1);
+    uint64_t lowMask = (1ULL << half) - 1;
+    uint64_t lower0 = lower >> half, lower1 = lower & lowMask;
+    const Level &previous = mLevels[size - 1];
+
+    if (lower == 0)
+    {
+        std::size_t i = std::upper_bound(previous.prefix.begin(), previous.prefix.end(), k) - previous.prefix.begin() - 1;
+        uint64_t high = previous.functions[i];
+
+        return high << half | select(size - 1, high, k - previous.prefix[i]);
+    }
+
+    for (uint64_t c : previous.functions)
+    {
+        if (lower0 & ~c)
+            continue;
+
+        uint64_t completions = countAbove(size - 1, c | lower1);
+
+        if (k < completions)
+            return c << half | select(size - 1, c | lower1, k);
+
+        k -= completions;
+    }
+
+    return 0;
+}
+
+widenum_t MonotoneRanking::unrank(int size, uint64_t k) const
+{
+    if (size < MAX_RANKING_SIZE)
+        return select(size, 0, k);
+
+    const std::vector<uint64_t> &prefix = mLevels[size - 1].prefix;
+    std::size_t i = std::upper_bound(prefix.begin(), prefix.end(), k) - prefix.begin() - 1;
+    uint64_t high = select(size - 1, 0, i);
+
+    return (widenum_t)high << 64 | select(size - 1, high, k - prefix[i]);
+}
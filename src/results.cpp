@@ -0,0 +1,540 @@
+#include <results.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char RESULT_MAGIC[8] = {'Q', 'M', 'F', 'R', 'E', 'S', 'L', 'T'};
+static const char INDEX_MAGIC[8] = {'Q', 'M', 'F', 'I', 'N', 'D', 'E', 'X'};
+static const uint32_t RESULT_VERSION = 1;
+
+enum BlockType : uint32_t {
+    FUNCTION_BLOCK = 1,
+    CHUNK_BLOCK = 2,
+    METADATA_BLOCK = 3,
+};
+
+struct ResultHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t size;
+    uint32_t alpha; // bit i holds alpha[i]
+    uint32_t reserved;
+};
+
+struct BlockHeader
+{
+    uint32_t type;
+    uint32_t count;
+    uint32_t bytes;
+    uint32_t crc;
+};
+
+struct ResultFooter
+{
+    uint64_t indexOffset;
+    uint64_t indexCount;
+    uint64_t functionCount;
+    uint32_t indexCrc;
+    uint32_t reserved;
+    char magic[8];
+};
+
+// offset, functions before, first number low and high word
+static const int INDEX_WORDS = 4;
+
+struct CrcTable
+{
+    uint32_t entries[256];
+
+    CrcTable()
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+
+            entries[i] = c;
+        }
+    }
+};
+
+// CRC-32 of zlib and PNG, reflected polynomial 0xEDB88320
+static uint32_t crc32(const void *data, std::size_t size)
+{
+    static const CrcTable table;
+
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    uint32_t crc = 0xFFFFFFFFu;
+
+    for (std::size_t i = 0; i < size; i++)
+        crc = table.entries[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+
+    return crc ^ 0xFFFFFFFFu;
+}
+
+static void putVarint(std::string &out, widenum_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((char)((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+
+    out.push_back((char)value);
+}
+
+// false when the varint runs past end or past 128 bits
+static bool getVarint(const unsigned char *&p, const unsigned char *end, widenum_t &value)
+{
+    value = 0;
+
+    for (int shift = 0; shift < 128 && p < end; shift += 7)
+    {
+        unsigned char byte = *p++;
+
+        value |= (widenum_t)(byte & 0x7F) << shift;
+
+        if (!(byte & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+ResultWriter::~ResultWriter()
+{
+    if (mFile)
+        close();
+}
+
+bool ResultWriter::open(const std::string &path, int size, const std::vector<int> &alpha)
+{
+    if (mFile)
+        close();
+
+    mPath = path;
+    mFailed = false;
+    mFunctionCount = 0;
+    mLast = 0;
+    mFunctions.clear();
+    mChunks.clear();
+    mMetadata.clear();
+    mIndex.clear();
+
+    // written aside and renamed, a reader never maps half a file
+    mFile = fopen((path + ".tmp").c_str(), "wb");
+
+    if (!mFile)
+        return false;
+
+    ResultHeader header;
+    std::memcpy(header.magic, RESULT_MAGIC, sizeof(header.magic));
+    header.version = RESULT_VERSION;
+    header.size = size;
+    header.alpha = 0;
+    header.reserved = 0;
+
+    for (std::size_t i = 0; i < alpha.size(); i++)
+    {
+        if (alpha[i])
+            header.alpha |= 1u << i;
+    }
+
+    mFailed = fwrite(&header, sizeof(header), 1, mFile) != 1;
+    mOffset = sizeof(header);
+
+    return !mFailed;
+}
+
+bool ResultWriter::writeBlock(uint32_t type, uint32_t count, const std::string &payload)
+{
+    BlockHeader header;
+    header.type = type;
+    header.count = count;
+    header.bytes = payload.size();
+    header.crc = crc32(payload.data(), payload.size());
+
+    if (fwrite(&header, sizeof(header), 1, mFile) != 1 || fwrite(payload.data(), 1, payload.size(), mFile) != payload.size())
+        mFailed = true;
+
+    mOffset += sizeof(header) + payload.size();
+
+    return !mFailed;
+}
+
+bool ResultWriter::flushFunctions()
+{
+    if (mFunctions.empty())
+        return !mFailed;
+
+    std::string payload;
+    payload.reserve(mFunctions.size() * 4);
+    putVarint(payload, mFunctions[0]);
+
+    for (std::size_t i = 1; i < mFunctions.size(); i++)
+        putVarint(payload, mFunctions[i] - mFunctions[i - 1]);
+
+    mIndex.push_back(mOffset);
+    mIndex.push_back(mFunctionCount - mFunctions.size());
+    mIndex.push_back((uint64_t)mFunctions[0]);
+    mIndex.push_back((uint64_t)(mFunctions[0] >> 64));
+
+    bool written = writeBlock(FUNCTION_BLOCK, mFunctions.size(), payload);
+    mFunctions.clear();
+
+    return written;
+}
+
+bool ResultWriter::flushChunks()
+{
+    if (mChunks.empty())
+        return !mFailed;
+
+    std::string payload;
+
+    for (auto &chunk : mChunks)
+    {
+        putVarint(payload, chunk.offset);
+        putVarint(payload, chunk.end - chunk.offset);
+        putVarint(payload, chunk.count);
+    }
+
+    bool written = writeBlock(CHUNK_BLOCK, mChunks.size(), payload);
+    mChunks.clear();
+
+    return written;
+}
+
+bool ResultWriter::addFunction(widenum_t functionNumber)
+{
+    if (!mFile || (mFunctionCount && functionNumber <= mLast))
+    {
+        mFailed = true;
+        return false;
+    }
+
+    mFunctions.push_back(functionNumber);
+    mLast = functionNumber;
+    mFunctionCount++;
+
+    return mFunctions.size() < BLOCK_FUNCTIONS || flushFunctions();
+}
+
+bool ResultWriter::addChunk(widenum_t offset, widenum_t end, uint64_t count)
+{
+    if (!mFile || end < offset)
+    {
+        mFailed = true;
+        return false;
+    }
+
+    mChunks.push_back({offset, end, count});
+
+    return mChunks.size() < BLOCK_FUNCTIONS || flushChunks();
+}
+
+void ResultWriter::setMetadata(const std::string &key, const std::string &value)
+{
+    for (auto &entry : mMetadata)
+    {
+        if (entry.first == key)
+        {
+            entry.second = value;
+            return;
+        }
+    }
+
+    mMetadata.push_back({key, value});
+}
+
+bool ResultWriter::close()
+{
+    if (!mFile)
+        return false;
+
+    flushFunctions();
+    flushChunks();
+
+    if (!mMetadata.empty())
+    {
+        std::string payload;
+
+        for (auto &entry : mMetadata)
+        {
+            putVarint(payload, entry.first.size());
+            payload += entry.first;
+            putVarint(payload, entry.second.size());
+            payload += entry.second;
+        }
+
+        writeBlock(METADATA_BLOCK, mMetadata.size(), payload);
+    }
+
+    ResultFooter footer;
+    footer.indexOffset = mOffset;
+    footer.indexCount = mIndex.size() / INDEX_WORDS;
+    footer.functionCount = mFunctionCount;
+    footer.indexCrc = crc32(mIndex.data(), mIndex.size() * sizeof(uint64_t));
+    footer.reserved = 0;
+    std::memcpy(footer.magic, INDEX_MAGIC, sizeof(footer.magic));
+
+    if (fwrite(mIndex.data(), sizeof(uint64_t), mIndex.size(), mFile) != mIndex.size() || fwrite(&footer, sizeof(footer), 1, mFile) != 1)
+        mFailed = true;
+
+    mFailed = fclose(mFile) != 0 || mFailed;
+    mFile = nullptr;
+
+    std::string temporaryPath = mPath + ".tmp";
+
+    if (mFailed || std::rename(temporaryPath.c_str(), mPath.c_str()) != 0)
+    {
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+ResultReader::~ResultReader()
+{
+    close();
+}
+
+void ResultReader::close()
+{
+    if (mData)
+        munmap(const_cast<unsigned char *>(mData), mFileSize);
+
+    mData = nullptr;
+    mFileSize = 0;
+    mSize = 0;
+    mAlpha.clear();
+    mFunctionCount = 0;
+    mBlocksEnd = 0;
+    mIndex.clear();
+    mChunks.clear();
+    mMetadata.clear();
+}
+
+bool ResultReader::open(const std::string &path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || (std::size_t)st.st_size < sizeof(ResultHeader) + sizeof(ResultFooter))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (data == MAP_FAILED)
+        return false;
+
+    mData = static_cast<const unsigned char *>(data);
+    mFileSize = st.st_size;
+
+    ResultHeader header;
+    ResultFooter footer;
+    std::memcpy(&header, mData, sizeof(header));
+    std::memcpy(&footer, mData + mFileSize - sizeof(footer), sizeof(footer));
+
+    uint64_t indexBytes = footer.indexCount * INDEX_WORDS * sizeof(uint64_t);
+
+    if (std::memcmp(header.magic, RESULT_MAGIC, sizeof(header.magic)) != 0 || header.version != RESULT_VERSION ||
+        header.size > MAX_NUMBER_SIZE || std::memcmp(footer.magic, INDEX_MAGIC, sizeof(footer.magic)) != 0 ||
+        footer.indexOffset < sizeof(header) || footer.indexOffset + indexBytes + sizeof(footer) != mFileSize)
+    {
+        close();
+        return false;
+    }
+
+    mIndex.resize(footer.indexCount * INDEX_WORDS);
+    std::memcpy(mIndex.data(), mData + footer.indexOffset, indexBytes);
+
+    if (crc32(mIndex.data(), indexBytes) != footer.indexCrc)
+    {
+        close();
+        return false;
+    }
+
+    mSize = header.size;
+    mFunctionCount = footer.functionCount;
+    mBlocksEnd = footer.indexOffset;
+
+    for (int i = 0; i < mSize; i++)
+        mAlpha.push_back((header.alpha >> i) & 1);
+
+    // chunks and metadata are small, decode them now
+    uint64_t offset = sizeof(header);
+
+    while (offset < mBlocksEnd)
+    {
+        BlockHeader block;
+
+        if (offset + sizeof(block) > mBlocksEnd)
+            break;
+
+        std::memcpy(&block, mData + offset, sizeof(block));
+        offset += sizeof(block);
+
+        const unsigned char *p = mData + offset;
+        const unsigned char *end = p + block.bytes;
+
+        if (offset + block.bytes > mBlocksEnd)
+            break;
+
+        offset += block.bytes;
+
+        if (block.type == FUNCTION_BLOCK)
+            continue;
+
+        if (crc32(p, block.bytes) != block.crc)
+            break;
+
+        bool decoded = true;
+
+        for (uint32_t i = 0; decoded && i < block.count; i++)
+        {
+            if (block.type == CHUNK_BLOCK)
+            {
+                widenum_t chunkOffset, length, count;
+
+                decoded = getVarint(p, end, chunkOffset) && getVarint(p, end, length) && getVarint(p, end, count);
+
+                if (decoded)
+                    mChunks.push_back({chunkOffset, chunkOffset + length, (uint64_t)count});
+            }
+            else if (block.type == METADATA_BLOCK)
+            {
+                widenum_t keySize, valueSize;
+                std::string key, value;
+
+                decoded = getVarint(p, end, keySize) && keySize <= (widenum_t)(end - p);
+
+                if (decoded)
+                {
+                    key.assign(reinterpret_cast<const char *>(p), (std::size_t)keySize);
+                    p += (std::size_t)keySize;
+                    decoded = getVarint(p, end, valueSize) && valueSize <= (widenum_t)(end - p);
+                }
+
+                if (decoded)
+                {
+                    value.assign(reinterpret_cast<const char *>(p), (std::size_t)valueSize);
+                    p += (std::size_t)valueSize;
+                    mMetadata.push_back({key, value});
+                }
+            }
+        }
+
+        if (!decoded)
+            break;
+    }
+
+    if (offset != mBlocksEnd)
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+bool ResultReader::readFunctions(widenum_t first, widenum_t last, const std::function<void(widenum_t)> &visit) const
+{
+    std::size_t blocks = mIndex.size() / INDEX_WORDS;
+
+    auto firstNumber = [this](std::size_t block) {
+        return (widenum_t)mIndex[block * INDEX_WORDS + 3] << 64 | mIndex[block * INDEX_WORDS + 2];
+    };
+
+    // the last block starting at or below first
+    std::size_t low = 0, high = blocks;
+
+    while (low < high)
+    {
+        std::size_t middle = (low + high) / 2;
+
+        if (firstNumber(middle) <= first)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    for (std::size_t block = low ? low - 1 : 0; block < blocks; block++)
+    {
+        uint64_t offset = mIndex[block * INDEX_WORDS];
+        BlockHeader header;
+
+        if (offset + sizeof(header) > mBlocksEnd)
+            return false;
+
+        std::memcpy(&header, mData + offset, sizeof(header));
+
+        const unsigned char *p = mData + offset + sizeof(header);
+        const unsigned char *end = p + header.bytes;
+
+        if (header.type != FUNCTION_BLOCK || offset + sizeof(header) + header.bytes > mBlocksEnd || crc32(p, header.bytes) != header.crc)
+            return false;
+
+        widenum_t value = 0;
+
+        for (uint32_t i = 0; i < header.count; i++)
+        {
+            widenum_t delta;
+
+            if (!getVarint(p, end, delta))
+                return false;
+
+            value = i ? value + delta : delta;
+
+            if (value > last)
+                return true;
+
+            if (value >= first)
+                visit(value);
+        }
+    }
+
+    return true;
+}
+
+bool ResultReader::verify() const
+{
+    uint64_t offset = sizeof(ResultHeader);
+
+    while (offset < mBlocksEnd)
+    {
+        BlockHeader header;
+
+        if (offset + sizeof(header) > mBlocksEnd)
+            return false;
+
+        std::memcpy(&header, mData + offset, sizeof(header));
+        offset += sizeof(header);
+
+        if (offset + header.bytes > mBlocksEnd || crc32(mData + offset, header.bytes) != header.crc)
+            return false;
+
+        offset += header.bytes;
+    }
+
+    return offset == mBlocksEnd;
+}
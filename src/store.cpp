@@ -0,0 +1,169 @@
+#include <store.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char STORE_MAGIC[8] = {'Q', 'M', 'F', 'S', 'T', 'O', 'R', 'E'};
+static const uint32_t STORE_VERSION = 1;
+
+// native byte order, the store is built on the machine that reads it
+struct StoreHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t size;
+    uint32_t alpha; // bit i holds alpha[i]
+    uint32_t indexStride;
+    uint64_t count;
+    uint64_t indexCount;
+};
+
+static uint32_t packAlpha(const std::vector<int> &alpha)
+{
+    uint32_t packed = 0;
+
+    for (std::size_t i = 0; i < alpha.size(); i++)
+    {
+        if (alpha[i])
+            packed |= 1u << i;
+    }
+
+    return packed;
+}
+
+MonotoneStore::~MonotoneStore()
+{
+    close();
+}
+
+std::string MonotoneStore::getFileName(int size, const std::vector<int> &alpha)
+{
+    std::string name = "monotone-" + std::to_string(size) + "-";
+
+    for (int a : alpha)
+        name += a ? '1' : '0';
+
+    return name + ".qms";
+}
+
+bool MonotoneStore::write(const std::string &path, int size, const std::vector<int> &alpha, const std::vector<uint64_t> &numbers)
+{
+    StoreHeader header;
+    std::memcpy(header.magic, STORE_MAGIC, sizeof(header.magic));
+    header.version = STORE_VERSION;
+    header.size = size;
+    header.alpha = packAlpha(alpha);
+    header.indexStride = INDEX_STRIDE;
+    header.count = numbers.size();
+    header.indexCount = (numbers.size() + INDEX_STRIDE - 1) / INDEX_STRIDE;
+
+    std::vector<uint64_t> index(header.indexCount);
+
+    for (uint64_t i = 0; i < header.indexCount; i++)
+        index[i] = numbers[i * INDEX_STRIDE];
+
+    // written aside and renamed, a reader never maps half a store
+    std::string temporaryPath = path + ".tmp";
+    FILE *file = fopen(temporaryPath.c_str(), "wb");
+
+    if (!file)
+        return false;
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(index.data(), sizeof(uint64_t), index.size(), file) == index.size() &&
+                   fwrite(numbers.data(), sizeof(uint64_t), numbers.size(), file) == numbers.size();
+
+    written = fclose(file) == 0 && written;
+
+    if (!written || std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool MonotoneStore::open(const std::string &path, int size, const std::vector<int> &alpha)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || (std::size_t)st.st_size < sizeof(StoreHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (data == MAP_FAILED)
+        return false;
+
+    const StoreHeader *header = static_cast<const StoreHeader *>(data);
+    std::size_t expected = sizeof(StoreHeader) + (header->indexCount + header->count) * sizeof(uint64_t);
+
+    if (std::memcmp(header->magic, STORE_MAGIC, sizeof(header->magic)) != 0 || header->version != STORE_VERSION ||
+        header->size != (uint32_t)size || header->alpha != packAlpha(alpha) || header->indexStride != INDEX_STRIDE ||
+        header->indexCount != (header->count + INDEX_STRIDE - 1) / INDEX_STRIDE || (std::size_t)st.st_size != expected)
+    {
+        munmap(data, st.st_size);
+        return false;
+    }
+
+    mData = data;
+    mSize = st.st_size;
+    mIndex = reinterpret_cast<const uint64_t *>(header + 1);
+    mIndexCount = header->indexCount;
+    mNumbers = mIndex + mIndexCount;
+    mCount = header->count;
+
+    return true;
+}
+
+void MonotoneStore::close()
+{
+    if (mData)
+        munmap(mData, mSize);
+
+    mData = nullptr;
+    mSize = 0;
+    mIndex = nullptr;
+    mNumbers = nullptr;
+    mIndexCount = 0;
+    mCount = 0;
+}
+
+uint64_t MonotoneStore::rank(uint64_t functionNumber) const
+{
+    // the last stride starting at or below the number holds its position
+    uint64_t stride = std::upper_bound(mIndex, mIndex + mIndexCount, functionNumber) - mIndex;
+
+    if (stride == 0)
+        return 0;
+
+    const uint64_t *begin = mNumbers + (stride - 1) * INDEX_STRIDE;
+    const uint64_t *end = mNumbers + std::min<uint64_t>(stride * INDEX_STRIDE, mCount);
+
+    return std::lower_bound(begin, end, functionNumber) - mNumbers;
+}
+
+bool MonotoneStore::contains(uint64_t functionNumber) const
+{
+    uint64_t position = rank(functionNumber);
+
+    return position < mCount && mNumbers[position] == functionNumber;
+}
@@ -0,0 +1,140 @@
+#include <truthtable.hpp>
+
+TruthTable::TruthTable(int size) : mSize(size), mWords((bitCount() + 63) / 64, 0)
+{
+}
+
+TruthTable TruthTable::fromNumber(widenum_t number, int size)
+{
+    TruthTable table(size);
+
+    for (std::size_t i = 0; i < table.wordCount() && i < 2; i++)
+    {
+        table.mWords[i] = (uint64_t)(number >> (64 * i));
+    }
+
+    if (table.bitCount() < 64)
+        table.mWords[0] &= (1ULL << table.bitCount()) - 1;
+
+    return table;
+}
+
+static int hexDigit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+
+    return -1;
+}
+
+bool TruthTable::parse(const std::string &text, int size, TruthTable &table)
+{
+    table = TruthTable(size);
+
+    if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X'))
+    {
+        std::size_t position = 0;
+
+        for (std::size_t i = text.size(); i-- > 2; position += 4)
+        {
+            int digit = hexDigit(text[i]);
+
+            if (digit < 0)
+                return false;
+
+            if (digit == 0)
+                continue;
+
+            // the highest set bit of the digit must stay inside the table
+            if (position + 64 - __builtin_clzll(digit) > table.bitCount())
+                return false;
+
+            table.mWords[position / 64] |= (uint64_t)digit << (position % 64);
+        }
+
+        return true;
+    }
+
+    widenum_t number;
+
+    if (!parseNumber(text, number))
+        return false;
+
+    if (size < MAX_NUMBER_SIZE && (number >> table.bitCount()) != 0)
+        return false;
+
+    table = fromNumber(number, size);
+
+    return true;
+}
+
+widenum_t TruthTable::toNumber() const
+{
+    widenum_t number = mWords[0];
+
+    if (mWords.size() > 1)
+        number |= (widenum_t)mWords[1] << 64;
+
+    return number;
+}
+
+std::string TruthTable::toHex() const
+{
+    static const char digits[] = "0123456789abcdef";
+
+    std::string hex;
+
+    for (std::size_t position = 0; position < bitCount(); position += 4)
+    {
+        hex.push_back(digits[(mWords[position / 64] >> (position % 64)) & 15]);
+    }
+
+    while (hex.size() > 1 && hex.back() == '0')
+        hex.pop_back();
+
+    return "0x" + std::string(hex.rbegin(), hex.rend());
+}
+
+std::string TruthTable::toString() const
+{
+    if (mSize <= MAX_NUMBER_SIZE)
+        return ::toString(toNumber());
+
+    return toHex();
+}
+
+std::string toString(widenum_t value)
+{
+    std::string digits;
+
+    do
+    {
+        digits.push_back('0' + (int)(value % 10));
+        value /= 10;
+    } while (value);
+
+    return std::string(digits.rbegin(), digits.rend());
+}
+
+bool parseNumber(const std::string &text, widenum_t &value)
+{
+    if (text.empty())
+        return false;
+
+    value = 0;
+
+    for (char c : text)
+    {
+        if (c < '0' || c > '9')
+            return false;
+
+        if (__builtin_mul_overflow(value, 10, &value) || __builtin_add_overflow(value, c - '0', &value))
+            return false;
+    }
+
+    return true;
+}